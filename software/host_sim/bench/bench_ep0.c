@@ -0,0 +1,242 @@
+/*******************************************************************************
+Copyright 2025 Custom USB Gamepad Project
+
+EP0 control transfer benchmark
+
+Runs an enumeration (the requests Windows sends to a new HID device), a
+mapping feature report read / write and one mapping command through the
+simulated device, then counts the transactions of every control transfer
+for each EP0 packet size and estimates their full-speed bus time.  The
+data stage lengths come from the firmware: descriptor sizes, wLength
+truncation and the short tag / command reports.
+
+  usage: sfcpad_ep0_bench [-l loop_us]
+
+A transfer takes a SETUP transaction, one transaction per data packet
+(plus a zero length packet when an IN data stage is shorter than wLength
+and ends on a packet boundary) and a status transaction.  Bus time counts
+the token, data and handshake packets at 12Mbit/s without bit stuffing,
+with 8 bit times of turnaround between packets.  In USB_POLLING mode the
+firmware serves EP0 once per main loop pass, so every transaction after
+the SETUP is also charged one pass of -l us (default 50) in "service".
+*******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "system.h"
+#include "usb.h"
+#include "usb_device_hid.h"
+#include "mapping.h"
+#include "usb_personality.h"
+#include "sim.h"
+
+#define TOKEN_BITS      35      // SYNC, PID, ADDR, ENDP, CRC5, EOP
+#define DATA_BITS       35      // SYNC, PID, CRC16, EOP (+ 8 per byte)
+#define HANDSHAKE_BITS  19      // SYNC, PID, EOP
+#define GAP_BITS        8       // bus turnaround between packets
+#define BIT_NS          83.33   // 12Mbit/s
+
+#define TRANSFERS_MAX   24
+
+/* One control transfer as the device served it */
+typedef struct {
+    uint8_t group;
+    uint16_t wLength;
+    uint16_t bytes;             // data stage bytes
+    bool in;
+    bool firstPacketOnly;       // the host stops after the first data packet
+} TRANSFER;
+
+enum {
+    GROUP_ENUMERATION = 0,
+    GROUP_MAPPING_READ,
+    GROUP_MAPPING_WRITE,
+    GROUP_MAP_COMMAND,
+    GROUPS
+};
+
+static const char *const groupNames[GROUPS] = {
+    "enumeration", "mapping_read", "mapping_write", "map_command"
+};
+
+static TRANSFER transfers[TRANSFERS_MAX];
+static uint8_t numTransfers;
+
+/**
+ * Run a control transfer through the simulated device and keep its size
+ * @param group GROUP_*
+ * @param setup 8 byte SETUP packet
+ * @param data Data stage buffer (sent for OUT, received for IN)
+ * @param firstPacketOnly The host reads only the first data packet
+ */
+static void Transfer(uint8_t group, const uint8_t *setup, uint8_t *data, bool firstPacketOnly) {
+    TRANSFER *t = &transfers[numTransfers++];
+    int len = SIM_USBControl(setup, data);
+
+    if (len < 0) {
+        fprintf(stderr, "request %02X %02X stalled\n", setup[0], setup[1]);
+        exit(1);
+    }
+    t->group = group;
+    t->wLength = (uint16_t)(setup[6] | (setup[7] << 8));
+    t->in = (setup[0] & 0x80) != 0;
+    t->bytes = t->in ? (uint16_t)len : t->wLength;
+    t->firstPacketOnly = firstPacketOnly;
+}
+
+/**
+ * Get the bus bits of one transaction
+ * @param bytes Data packet payload
+ * @return Bits on the bus
+ */
+static uint32_t TransactionBits(uint16_t bytes) {
+    return TOKEN_BITS + GAP_BITS + DATA_BITS + 8u * bytes + GAP_BITS + HANDSHAKE_BITS;
+}
+
+/**
+ * Count the transactions and bus bits of a transfer
+ * @param t Transfer
+ * @param mps EP0 packet size
+ * @param bits Bus bits, added to
+ * @return Number of transactions
+ */
+static uint16_t Cost(const TRANSFER *t, uint8_t mps, uint32_t *bits) {
+    uint16_t left = t->bytes;
+    uint16_t n = 2;             // SETUP and status
+
+    *bits += TransactionBits(8) + TransactionBits(0);
+    while (left != 0) {
+        uint16_t packet = (left < mps) ? left : mps;
+
+        *bits += TransactionBits(packet);
+        n++;
+        left -= packet;
+        if (t->firstPacketOnly) return n;
+    }
+    if (t->in && t->bytes != 0 && t->bytes < t->wLength && t->bytes % mps == 0) {
+        *bits += TransactionBits(0);
+        n++;
+    }
+    return n;
+}
+
+/**
+ * Run the enumeration and the mapping transfers
+ */
+static void RunTransfers(void) {
+    uint8_t buf[256];
+    uint8_t setup[8];
+    uint8_t strings[3];
+
+    // Device descriptor: first packet only, then the bus reset and SET_ADDRESS
+    memcpy(setup, (const uint8_t[8]){ 0x80, USB_REQUEST_GET_DESCRIPTOR, 0, USB_DESCRIPTOR_DEVICE, 0, 0, 64, 0 }, 8);
+    Transfer(GROUP_ENUMERATION, setup, buf, true);
+    memcpy(setup, (const uint8_t[8]){ 0x00, USB_REQUEST_SET_ADDRESS, 1, 0, 0, 0, 0, 0 }, 8);
+    Transfer(GROUP_ENUMERATION, setup, buf, false);
+    memcpy(setup, (const uint8_t[8]){ 0x80, USB_REQUEST_GET_DESCRIPTOR, 0, USB_DESCRIPTOR_DEVICE, 0, 0, 18, 0 }, 8);
+    Transfer(GROUP_ENUMERATION, setup, buf, false);
+    memcpy(strings, &buf[14], sizeof(strings));    // iManufacturer, iProduct, iSerialNumber
+
+    // Configuration descriptor: header, then all of it
+    memcpy(setup, (const uint8_t[8]){ 0x80, USB_REQUEST_GET_DESCRIPTOR, 0, USB_DESCRIPTOR_CONFIGURATION, 0, 0, 9, 0 }, 8);
+    Transfer(GROUP_ENUMERATION, setup, buf, false);
+    setup[6] = 0xFF;
+    Transfer(GROUP_ENUMERATION, setup, buf, false);
+
+    // Language IDs and the strings the device descriptor names
+    memcpy(setup, (const uint8_t[8]){ 0x80, USB_REQUEST_GET_DESCRIPTOR, 0, USB_DESCRIPTOR_STRING, 0, 0, 0xFF, 0 }, 8);
+    Transfer(GROUP_ENUMERATION, setup, buf, false);
+    setup[4] = 0x09;            // English (US)
+    setup[5] = 0x04;
+    for (uint8_t i = 0; i < sizeof(strings); i++) {
+        if (strings[i] == 0) continue;
+        setup[2] = strings[i];
+        Transfer(GROUP_ENUMERATION, setup, buf, false);
+    }
+
+    memcpy(setup, (const uint8_t[8]){ 0x00, USB_REQUEST_SET_CONFIGURATION, 1, 0, 0, 0, 0, 0 }, 8);
+    Transfer(GROUP_ENUMERATION, setup, buf, false);
+    SIM_USBConfigure();
+
+    // HID: SET_IDLE and the report descriptors of both interfaces
+    for (uint8_t intf = 0; intf < 2; intf++) {
+        uint16_t size = (intf == 0) ? USBPersonality->reportSize : HID_MAP_RPT_DESC_SIZE;
+
+        memcpy(setup, (const uint8_t[8]){ 0x21, SET_IDLE, 0, 0, 0, 0, 0, 0 }, 8);
+        setup[4] = intf;
+        Transfer(GROUP_ENUMERATION, setup, buf, false);
+        memcpy(setup, (const uint8_t[8]){ 0x81, USB_REQUEST_GET_DESCRIPTOR, 0, DSC_RPT, 0, 0, 0, 0 }, 8);
+        setup[4] = intf;
+        setup[6] = (uint8_t)(size + 0x40);   // Windows asks for 64 bytes more
+        Transfer(GROUP_ENUMERATION, setup, buf, false);
+    }
+
+    // Mapping feature report: read, change one byte, write back
+    memcpy(setup, (const uint8_t[8]){ 0xA1, GET_REPORT, MAP_REPORT_ID, 0x03, 1, 0, HID_MAP_EP_BUF_SIZE, 0 }, 8);
+    Transfer(GROUP_MAPPING_READ, setup, buf, false);
+    buf[4] = 0;
+    setup[0] = 0x21;
+    setup[1] = SET_REPORT;
+    Transfer(GROUP_MAPPING_WRITE, setup, buf, false);
+
+    // The same kind of change as one command, and its result
+    memcpy(buf, (const uint8_t[6]){ MAP_CMD_REPORT_ID, MAP_CMD_SET_ENTRY, 0, PHYS_BTN_A, 2, 0 }, 6);
+    memcpy(setup, (const uint8_t[8]){ 0x21, SET_REPORT, MAP_CMD_REPORT_ID, 0x03, 1, 0, 6, 0 }, 8);
+    Transfer(GROUP_MAP_COMMAND, setup, buf, false);
+    setup[0] = 0xA1;
+    setup[1] = GET_REPORT;
+    setup[6] = HID_MAP_EP_BUF_SIZE;
+    Transfer(GROUP_MAP_COMMAND, setup, buf, false);
+}
+
+int main(int argc, char **argv) {
+    static const uint8_t sizes[] = { 8, 16, 32, 64 };
+    unsigned loopUs = 50;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+            loopUs = (unsigned)strtoul(argv[++i], NULL, 0);
+        } else {
+            fprintf(stderr, "usage: %s [-l loop_us]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    simOut = NULL;
+    SIM_SetButtons(0);
+    Mapping_Load();
+    USBPersonalitySelect(Mapping_GetPersonality(), 0);
+    RunTransfers();
+
+    printf("# device EP0 size %u, main loop %uus\n", USBPersonality->device[7], loopUs);
+    printf("# %-4s %-14s %6s %8s %10s\n", "ep0", "transfers", "trans", "bus_us", "service_us");
+    for (uint8_t s = 0; s < sizeof(sizes); s++) {
+        unsigned cycleTrans = 0;
+        unsigned cycleWaits = 0;
+        uint32_t cycleBits = 0;
+
+        for (uint8_t g = 0; g < GROUPS; g++) {
+            unsigned trans = 0;
+            unsigned waits = 0;
+            uint32_t bits = 0;
+
+            for (uint8_t i = 0; i < numTransfers; i++) {
+                uint16_t n;
+
+                if (transfers[i].group != g) continue;
+                n = Cost(&transfers[i], sizes[s], &bits);
+                trans += n;
+                waits += n - 1u;        // every stage after the SETUP
+            }
+            printf("  %-4u %-14s %6u %8.1f %10u\n", sizes[s], groupNames[g], trans, bits * BIT_NS / 1000, waits * loopUs);
+            if (g != GROUP_MAP_COMMAND) {
+                cycleTrans += trans;
+                cycleWaits += waits;
+                cycleBits += bits;
+            }
+        }
+        // Enumeration plus one mapping read / write cycle
+        printf("  %-4u %-14s %6u %8.1f %10u\n", sizes[s], "cycle", cycleTrans, cycleBits * BIT_NS / 1000, cycleWaits * loopUs);
+    }
+    return 0;
+}
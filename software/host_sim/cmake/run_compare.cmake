@@ -0,0 +1,15 @@
+# Runs CMD and compares its output with the EXPECTED file.
+get_filename_component(name ${EXPECTED} NAME_WE)
+
+execute_process(COMMAND ${CMD}
+    OUTPUT_VARIABLE actual
+    RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "${CMD} failed (${result})")
+endif()
+
+file(READ ${EXPECTED} expected)
+if(NOT actual STREQUAL expected)
+    file(WRITE ${CMAKE_CURRENT_BINARY_DIR}/${name}.actual "${actual}")
+    message(FATAL_ERROR "${name}: output differs from ${name}.expected, see ${name}.actual")
+endif()
@@ -0,0 +1,21 @@
+# Replays TRACE with SIM and compares the output with TRACE's .expected file.
+# Simulator options can be given on a "#! " line at the top of the trace.
+get_filename_component(dir ${TRACE} DIRECTORY)
+get_filename_component(name ${TRACE} NAME_WE)
+
+file(STRINGS ${TRACE} opts LIMIT_COUNT 1 REGEX "^#! ")
+string(REGEX REPLACE "^#! " "" opts "${opts}")
+separate_arguments(opts)
+
+execute_process(COMMAND ${SIM} ${opts} ${TRACE}
+    OUTPUT_VARIABLE actual
+    RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "sfcpad_sim failed (${result})")
+endif()
+
+file(READ ${dir}/${name}.expected expected)
+if(NOT actual STREQUAL expected)
+    file(WRITE ${CMAKE_CURRENT_BINARY_DIR}/${name}.actual "${actual}")
+    message(FATAL_ERROR "${name}: output differs from ${name}.expected, see ${name}.actual")
+endif()
@@ -0,0 +1,241 @@
+/*******************************************************************************
+Copyright 2025 Custom USB Gamepad Project
+
+Host build stand-in for the XC8 device header (PIC16F1459)
+
+Only the special function registers the application layer and the USB
+headers touch are provided.  Every register is a plain byte in host
+memory (see sim_regs.c); the bit views alias the same byte, as on the
+device.  Nothing happens on a register write: the simulator
+(sim_usb.c, sim_main.c) updates PORTx, TMR0, TMR1, INTCON, the IOC
+flags and PLLRDY between main loop iterations.  SLEEP() runs the
+simulation until an enabled wake-up source fires (SIM_Sleep()); _delay()
+and a read of OSCSTAT while the PLL is locking let simulated time pass.
+*******************************************************************************/
+
+#ifndef SIM_XC_H
+#define SIM_XC_H
+
+#include <stdint.h>
+
+/* XC8 storage qualifiers and intrinsics */
+#define __at(address)
+#define __interrupt(...)
+#define __section(name)
+#define __persistent
+#define NOP()
+#define CLRWDT()
+#define SLEEP()             SIM_Sleep()
+#define di()                (INTCONbits.GIE = 0)
+#define ei()                (INTCONbits.GIE = 1)
+#define _delay(cycles)      SIM_Delay(cycles)
+
+void SIM_Sleep(void);
+void SIM_Delay(uint32_t cycles);
+
+/* ── I/O ports ────────────────────────────────────────────────────────────── */
+typedef struct {
+    unsigned RA0 :1;
+    unsigned RA1 :1;
+    unsigned RA2 :1;
+    unsigned RA3 :1;
+    unsigned RA4 :1;
+    unsigned RA5 :1;
+    unsigned :2;
+} PORTAbits_t;
+
+typedef struct {
+    unsigned :4;
+    unsigned RB4 :1;
+    unsigned RB5 :1;
+    unsigned RB6 :1;
+    unsigned RB7 :1;
+} PORTBbits_t;
+
+typedef struct {
+    unsigned RC0 :1;
+    unsigned RC1 :1;
+    unsigned RC2 :1;
+    unsigned RC3 :1;
+    unsigned RC4 :1;
+    unsigned RC5 :1;
+    unsigned RC6 :1;
+    unsigned RC7 :1;
+} PORTCbits_t;
+
+extern volatile uint8_t PORTA;
+extern volatile uint8_t PORTB;
+extern volatile uint8_t PORTC;
+extern volatile uint8_t TRISA;
+extern volatile uint8_t TRISB;
+extern volatile uint8_t TRISC;
+extern volatile uint8_t WPUA;
+extern volatile uint8_t WPUB;
+extern volatile uint8_t ANSELA;
+extern volatile uint8_t ANSELB;
+extern volatile uint8_t ANSELC;
+
+#define PORTAbits   (*(volatile PORTAbits_t*)&PORTA)
+#define PORTBbits   (*(volatile PORTBbits_t*)&PORTB)
+#define PORTCbits   (*(volatile PORTCbits_t*)&PORTC)
+
+/* Interrupt-on-change (PORTA / PORTB only on the PIC16F1459) */
+extern volatile uint8_t IOCAN;
+extern volatile uint8_t IOCAF;
+extern volatile uint8_t IOCBN;
+extern volatile uint8_t IOCBF;
+
+/* ── Oscillator / watchdog ────────────────────────────────────────────────── */
+typedef struct {
+    unsigned HFIOFS :1;
+    unsigned LFIOFR :1;
+    unsigned MFIOFR :1;
+    unsigned HFIOFL :1;
+    unsigned HFIOFR :1;
+    unsigned OSTS :1;
+    unsigned PLLRDY :1;
+    unsigned SOSCR :1;
+} OSCSTATbits_t;
+
+extern volatile uint8_t OSCCON;
+extern volatile uint8_t OSCSTAT;
+extern volatile uint8_t ACTCON;
+extern volatile uint8_t WDTCON;
+
+#define OSCSTATbits (*(volatile OSCSTATbits_t*)SIM_OscStat())
+
+volatile uint8_t *SIM_OscStat(void);
+
+/* ── Timer0 / Timer1 / interrupts ─────────────────────────────────────────── */
+typedef struct {
+    unsigned PS :3;
+    unsigned PSA :1;
+    unsigned TMR0SE :1;
+    unsigned TMR0CS :1;
+    unsigned INTEDG :1;
+    unsigned nWPUEN :1;
+} OPTION_REGbits_t;
+
+typedef struct {
+    unsigned TMR0 :8;
+} TMR0bits_t;
+
+typedef struct {
+    unsigned TMR1ON :1;
+    unsigned :1;
+    unsigned nT1SYNC :1;
+    unsigned T1OSCEN :1;
+    unsigned T1CKPS :2;
+    unsigned TMR1CS :2;
+} T1CONbits_t;
+
+typedef struct {
+    unsigned IOCIF :1;
+    unsigned INTF :1;
+    unsigned TMR0IF :1;
+    unsigned IOCIE :1;
+    unsigned INTE :1;
+    unsigned TMR0IE :1;
+    unsigned PEIE :1;
+    unsigned GIE :1;
+} INTCONbits_t;
+
+typedef struct {
+    unsigned TMR1IF :1;
+    unsigned :7;
+} PIR1bits_t;
+
+typedef struct {
+    unsigned :2;
+    unsigned USBIE :1;
+    unsigned :5;
+} PIE2bits_t;
+
+typedef struct {
+    unsigned :2;
+    unsigned USBIF :1;
+    unsigned :5;
+} PIR2bits_t;
+
+extern volatile uint8_t OPTION_REG;
+extern volatile uint8_t TMR0;
+extern volatile uint8_t T1CON;
+extern volatile uint8_t TMR1L;
+extern volatile uint8_t TMR1H;
+extern volatile uint8_t INTCON;
+extern volatile uint8_t PIR1;
+extern volatile uint8_t PIE2;
+extern volatile uint8_t PIR2;
+
+#define OPTION_REGbits  (*(volatile OPTION_REGbits_t*)&OPTION_REG)
+#define TMR0bits        (*(volatile TMR0bits_t*)&TMR0)
+#define T1CONbits       (*(volatile T1CONbits_t*)&T1CON)
+#define PIR1bits        (*(volatile PIR1bits_t*)&PIR1)
+#define INTCONbits      (*(volatile INTCONbits_t*)&INTCON)
+#define PIE2bits        (*(volatile PIE2bits_t*)&PIE2)
+#define PIR2bits        (*(volatile PIR2bits_t*)&PIR2)
+
+/* ── Flash program memory control ─────────────────────────────────────────── */
+typedef struct {
+    unsigned RD :1;
+    unsigned WR :1;
+    unsigned WREN :1;
+    unsigned WRERR :1;
+    unsigned FREE :1;
+    unsigned LWLO :1;
+    unsigned CFGS :1;
+    unsigned :1;
+} PMCON1bits_t;
+
+extern volatile uint8_t PMCON1;
+extern volatile uint8_t PMCON2;
+extern volatile uint8_t PMADRL;
+extern volatile uint8_t PMADRH;
+extern volatile uint8_t PMDATL;
+extern volatile uint8_t PMDATH;
+
+#define PMCON1bits  (*(volatile PMCON1bits_t*)&PMCON1)
+
+/* ── USB module ───────────────────────────────────────────────────────────── */
+typedef struct {
+    unsigned :1;
+    unsigned SUSPND :1;
+    unsigned RESUME :1;
+    unsigned USBEN :1;
+    unsigned PKTDIS :1;
+    unsigned SE0 :1;
+    unsigned PPBRST :1;
+    unsigned :1;
+} UCONbits_t;
+
+typedef struct {
+    unsigned URSTIF :1;
+    unsigned UERRIF :1;
+    unsigned ACTVIF :1;
+    unsigned TRNIF :1;
+    unsigned IDLEIF :1;
+    unsigned STALLIF :1;
+    unsigned SOFIF :1;
+    unsigned :1;
+} UIRbits_t;
+
+typedef struct {
+    unsigned URSTIE :1;
+    unsigned UERRIE :1;
+    unsigned ACTVIE :1;
+    unsigned TRNIE :1;
+    unsigned IDLEIE :1;
+    unsigned STALLIE :1;
+    unsigned SOFIE :1;
+    unsigned :1;
+} UIEbits_t;
+
+extern volatile uint8_t UCON;
+extern volatile uint8_t UIR;
+extern volatile uint8_t UIE;
+
+#define UCONbits    (*(volatile UCONbits_t*)&UCON)
+#define UIRbits     (*(volatile UIRbits_t*)&UIR)
+#define UIEbits     (*(volatile UIEbits_t*)&UIE)
+
+#endif /* SIM_XC_H */
@@ -0,0 +1,151 @@
+/*******************************************************************************
+Copyright 2025 Custom USB Gamepad Project
+
+Host encoder / decoder of the macro format (see macro.h)
+*******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "io_mapping.h"
+#include "macro_codec.h"
+
+static const struct {
+    const char *name;
+    uint16_t snap;
+} buttonNames[] = {
+    { "A",      BUTTON_SNAP_A },
+    { "B",      BUTTON_SNAP_B },
+    { "X",      BUTTON_SNAP_X },
+    { "Y",      BUTTON_SNAP_Y },
+    { "L",      BUTTON_SNAP_TL },
+    { "R",      BUTTON_SNAP_TR },
+    { "SELECT", BUTTON_SNAP_SELECT },
+    { "START",  BUTTON_SNAP_START },
+    { "UP",     BUTTON_SNAP_UP },
+    { "DOWN",   BUTTON_SNAP_DOWN },
+    { "LEFT",   BUTTON_SNAP_LEFT },
+    { "RIGHT",  BUTTON_SNAP_RIGHT }
+};
+
+#define NUM_NAMES   (sizeof(buttonNames) / sizeof(buttonNames[0]))
+
+int MacroCodec_Encode(const MACRO_RUN *runs, size_t n, MACRO_STEP *steps) {
+    int used = 0;
+
+    for (size_t i = 0; i < n; ) {
+        uint16_t snap = runs[i].snap & BUTTON_SNAP_MASK;
+        uint64_t frames = 0;
+
+        // merge adjacent runs of the same state
+        do {
+            frames += runs[i].frames;
+            i++;
+        } while (i < n && (runs[i].snap & BUTTON_SNAP_MASK) == snap);
+        if (frames == 0) return -1;
+
+        while (frames != 0) {
+            uint16_t chunk = (frames > MACRO_FRAMES_MAX) ? MACRO_FRAMES_MAX : (uint16_t)frames;
+
+            if (used >= MACRO_STEPS) return -1;
+            steps[used].snap = snap;
+            steps[used].frames = chunk;
+            used++;
+            frames -= chunk;
+        }
+    }
+    return used;
+}
+
+int MacroCodec_Decode(const MACRO_STEP *steps, uint8_t length, MACRO_RUN *runs, size_t max) {
+    size_t n = 0;
+
+    if (length == 0 || length > MACRO_STEPS) return -1;
+
+    for (uint8_t i = 0; i < length; i++) {
+        if (n != 0 && runs[n - 1].snap == steps[i].snap) {
+            runs[n - 1].frames += steps[i].frames;
+        } else {
+            if (n == max) return -1;
+            runs[n].snap = steps[i].snap;
+            runs[n].frames = steps[i].frames;
+            n++;
+        }
+    }
+    return (int)n;
+}
+
+bool MacroCodec_Load(const char *path, MACRO_STEP *steps, uint8_t *length) {
+    uint8_t buf[MACRO_STEPS * 4 + 1];
+    FILE *f = fopen(path, "rb");
+    size_t size;
+
+    if (f == NULL) return false;
+    size = fread(buf, 1, sizeof(buf), f);
+    fclose(f);
+    if (size % 4 != 0 || size > MACRO_STEPS * 4) return false;
+
+    for (size_t i = 0; i < size / 4; i++) {
+        steps[i].snap = (uint16_t)(buf[4 * i] | (buf[4 * i + 1] << 8));
+        steps[i].frames = (uint16_t)(buf[4 * i + 2] | (buf[4 * i + 3] << 8));
+    }
+    *length = (uint8_t)(size / 4);
+    return true;
+}
+
+bool MacroCodec_Save(const char *path, const MACRO_STEP *steps, uint8_t length) {
+    uint8_t buf[MACRO_STEPS * 4];
+    FILE *f = fopen(path, "wb");
+    bool ok;
+
+    if (f == NULL) return false;
+    for (uint8_t i = 0; i < length; i++) {
+        buf[4 * i] = (uint8_t)steps[i].snap;
+        buf[4 * i + 1] = (uint8_t)(steps[i].snap >> 8);
+        buf[4 * i + 2] = (uint8_t)steps[i].frames;
+        buf[4 * i + 3] = (uint8_t)(steps[i].frames >> 8);
+    }
+    ok = fwrite(buf, 4, length, f) == length;
+    fclose(f);
+    return ok;
+}
+
+int MacroCodec_ParseLine(const char *line, MACRO_RUN *run) {
+    char buf[256];
+    char *tok;
+    char *end;
+    unsigned long frames;
+
+    strncpy(buf, line, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = '\0';
+    if ((end = strchr(buf, '#')) != NULL) *end = '\0';
+
+    if ((tok = strtok(buf, " \t\r\n")) == NULL) return 0;
+    frames = strtoul(tok, &end, 0);
+    if (*end != '\0' || frames == 0) return -1;
+
+    run->frames = (uint32_t)frames;
+    run->snap = 0;
+    while ((tok = strtok(NULL, " \t\r\n")) != NULL) {
+        size_t i;
+
+        if (strcmp(tok, "-") == 0) continue;
+        for (i = 0; i < NUM_NAMES; i++) {
+            if (strcmp(tok, buttonNames[i].name) == 0) break;
+        }
+        if (i == NUM_NAMES) return -1;
+        run->snap |= buttonNames[i].snap;
+    }
+    return 1;
+}
+
+void MacroCodec_PrintRun(FILE *f, const MACRO_RUN *run) {
+    fprintf(f, "%lu", (unsigned long)run->frames);
+    if (run->snap == 0) {
+        fprintf(f, " -");
+        return;
+    }
+    for (size_t i = 0; i < NUM_NAMES; i++) {
+        if (run->snap & buttonNames[i].snap) fprintf(f, " %s", buttonNames[i].name);
+    }
+}
@@ -0,0 +1,72 @@
+/*******************************************************************************
+Copyright 2025 Custom USB Gamepad Project
+
+Host encoder / decoder of the macro format (see macro.h)
+*******************************************************************************/
+
+#ifndef MACRO_CODEC_H
+#define MACRO_CODEC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "macro.h"
+
+/* One state of a macro and how many frames it lasts */
+typedef struct {
+    uint16_t snap;          // BUTTON_SNAP_* bits
+    uint32_t frames;        // at least 1
+} MACRO_RUN;
+
+/**
+ * Encode runs into macro steps
+ * Adjacent runs of the same state are merged, runs over MACRO_FRAMES_MAX
+ * frames take several steps.
+ * @param runs Runs in play order
+ * @param n Number of runs
+ * @param steps Buffer of MACRO_STEPS steps
+ * @return Steps used, or -1 if the runs do not fit
+ */
+int MacroCodec_Encode(const MACRO_RUN *runs, size_t n, MACRO_STEP *steps);
+
+/**
+ * Decode macro steps
+ * Adjacent steps of the same state are merged into one run.
+ * @param steps Steps of the macro
+ * @param length Number of steps, 0 for no macro
+ * @param runs Buffer for the runs
+ * @param max Size of the buffer
+ * @return Number of runs, or -1 without a macro or if the buffer is too small
+ */
+int MacroCodec_Decode(const MACRO_STEP *steps, uint8_t length, MACRO_RUN *runs, size_t max);
+
+/**
+ * Load / save a macro image
+ * The image holds the steps of the macro, 4 bytes each: the BUTTON_SNAP_*
+ * bits and the frames, little endian.  An empty image is no macro.
+ * @param path Image file
+ * @param steps Buffer of MACRO_STEPS steps
+ * @param length Number of steps
+ * @return true on success
+ */
+bool MacroCodec_Load(const char *path, MACRO_STEP *steps, uint8_t *length);
+bool MacroCodec_Save(const char *path, const MACRO_STEP *steps, uint8_t length);
+
+/**
+ * Parse one text line "<frames> <button>..." ('-' for no button)
+ * Button names are the trace names: A B X Y L R SELECT START UP DOWN LEFT RIGHT.
+ * @param line Text line, '#' starts a comment
+ * @param run Parsed run
+ * @return 1 for a run, 0 for a blank line, -1 on a syntax error
+ */
+int MacroCodec_ParseLine(const char *line, MACRO_RUN *run);
+
+/**
+ * Print a run in the text format (without a newline)
+ * @param f Output stream
+ * @param run Run
+ */
+void MacroCodec_PrintRun(FILE *f, const MACRO_RUN *run);
+
+#endif /* MACRO_CODEC_H */
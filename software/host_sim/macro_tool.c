@@ -0,0 +1,92 @@
+/*******************************************************************************
+Copyright 2025 Custom USB Gamepad Project
+
+Macro image encoder / decoder
+
+  usage: macro_tool encode macro.txt macro.bin
+         macro_tool decode macro.bin
+
+The text form has one run per line, "<frames> <button>..." with '-' for
+no button, e.g. "3 A RIGHT" holds A and right for 3 frames.  The image
+holds the macro steps (see MacroCodec_Load()), as read by sfcpad_sim -m.
+*******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "macro.h"
+#include "macro_codec.h"
+
+#define RUNS_MAX    256
+
+static int Encode(const char *in, const char *out) {
+    static MACRO_RUN runs[RUNS_MAX];
+    MACRO_STEP steps[MACRO_STEPS];
+    char line[256];
+    unsigned lineNo = 0;
+    size_t n = 0;
+    int used;
+    FILE *f;
+
+    if ((f = fopen(in, "r")) == NULL) {
+        perror(in);
+        return 2;
+    }
+    while (fgets(line, sizeof(line), f) != NULL) {
+        int r;
+
+        lineNo++;
+        if (n == RUNS_MAX) {
+            fprintf(stderr, "%s:%u: too many runs\n", in, lineNo);
+            return 1;
+        }
+        r = MacroCodec_ParseLine(line, &runs[n]);
+        if (r < 0) {
+            fprintf(stderr, "%s:%u: \"<frames> <button>...\" expected\n", in, lineNo);
+            return 1;
+        }
+        n += (size_t)r;
+    }
+    fclose(f);
+
+    if ((used = MacroCodec_Encode(runs, n, steps)) < 0) {
+        fprintf(stderr, "%s: does not fit in %u steps\n", in, MACRO_STEPS);
+        return 1;
+    }
+    if (!MacroCodec_Save(out, steps, (uint8_t)used)) {
+        perror(out);
+        return 2;
+    }
+    fprintf(stderr, "%s: %d of %u steps\n", out, used, MACRO_STEPS);
+    return 0;
+}
+
+static int Decode(const char *in) {
+    static MACRO_RUN runs[RUNS_MAX];
+    MACRO_STEP steps[MACRO_STEPS];
+    uint8_t length;
+    int n;
+
+    if (!MacroCodec_Load(in, steps, &length)) {
+        fprintf(stderr, "%s: not a macro image\n", in);
+        return 2;
+    }
+
+    if ((n = MacroCodec_Decode(steps, length, runs, RUNS_MAX)) < 0) {
+        fprintf(stderr, "%s: no macro\n", in);
+        return 1;
+    }
+    for (int i = 0; i < n; i++) {
+        MacroCodec_PrintRun(stdout, &runs[i]);
+        putchar('\n');
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc == 4 && strcmp(argv[1], "encode") == 0) return Encode(argv[2], argv[3]);
+    if (argc == 3 && strcmp(argv[1], "decode") == 0) return Decode(argv[2]);
+
+    fprintf(stderr, "usage: %s encode macro.txt macro.bin\n"
+                    "       %s decode macro.bin\n", argv[0], argv[0]);
+    return 2;
+}
@@ -0,0 +1,99 @@
+/*******************************************************************************
+Copyright 2025 Custom USB Gamepad Project
+
+Host simulator of the SFC gamepad firmware
+*******************************************************************************/
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#define SIM_FRAME_US    1000u       // USB full speed frame
+#define SIM_FOSC_HZ     48000000u   // 48MHz PLL, Fcy = Fosc/4
+#define SIM_TMR0_PS     256u        // Timer0 prescaler set by main()
+
+/* Simulated time in microseconds since plug-in */
+extern uint32_t simTimeUs;
+
+/* Capture output (every armed report and every host pickup), NULL = off */
+extern FILE *simOut;
+
+/* Leave the TX / IN / AGE lines out of the capture output */
+extern bool simQuiet;
+
+/**
+ * Advance the simulated time
+ * Updates TMR0 / INTCONbits.TMR0IF, latches SOF for SIM_USBTasks() and
+ * lets the host pick up an armed EP1 IN report at its poll phase.
+ * @param us New simulated time (not earlier than simTimeUs)
+ */
+void SIM_AdvanceTo(uint32_t us);
+
+/**
+ * Set the pins of the physical buttons
+ * @param snap Pressed buttons as BUTTON_SNAP_* bits (active high)
+ */
+void SIM_SetButtons(uint16_t snap);
+
+/**
+ * Enumerate the device: configure it and raise EVENT_CONFIGURED
+ */
+void SIM_USBConfigure(void);
+
+/**
+ * Host suspends the bus: no SOF and no polls from now on
+ * The device layer suspends the firmware after 3ms of idle.
+ */
+void SIM_USBSuspend(void);
+
+/**
+ * Host resumes a suspended bus (20ms of resume signalling, then SOFs)
+ */
+void SIM_USBResume(void);
+
+/* Run while the firmware sleeps in SLEEP() (the trace player), NULL = none */
+extern void (*simSleepTask)(void);
+
+/**
+ * Host poll phase of the EP1 IN endpoint
+ * @param us Offset from SOF in microseconds (0 to SIM_FRAME_US-1)
+ */
+void SIM_USBSetPollPhase(uint32_t us);
+
+/**
+ * Deliver pending USB events to the firmware (USBDeviceTasks())
+ */
+void SIM_USBTasks(void);
+
+/**
+ * Host pickups of EP1 IN reports since the last call
+ * @param maxGapUs Longest time between two pickups in that span, the
+ *                 first one measured from the pickup before it
+ * @return Number of pickups
+ */
+uint32_t SIM_USBCadence(uint32_t *maxGapUs);
+
+/**
+ * Run a control transfer on EP0 through the firmware request handlers
+ * @param setup 8 byte SETUP packet
+ * @param data OUT data stage, or buffer for the IN data stage
+ * @return Bytes of the IN data stage, or -1 if nobody claimed the request
+ */
+int SIM_USBControl(const uint8_t *setup, uint8_t *data);
+
+/**
+ * Load / save the High-Endurance Flash image
+ * @param path Binary file of the HEF rows (little endian words)
+ * @return true on success
+ */
+bool SIM_FlashLoad(const char *path);
+bool SIM_FlashSave(const char *path);
+
+/* Number of flash row erases / row writes since start */
+extern uint16_t simFlashErases;
+extern uint16_t simFlashWrites;
+
+#endif /* SIM_H */
@@ -0,0 +1,483 @@
+/*******************************************************************************
+Copyright 2025 Custom USB Gamepad Project
+
+Input trace player
+
+Runs the firmware main loop over simulated time, drives the button pins
+from a trace file and prints every report armed on EP1 (TX), every
+report the host picked up (IN, followed by its age in us), the data
+of feature report reads (FR), mapping tag reads (TAG), mapping command
+results (CMD), the latency statistics (LAT), the report cadence (CAD),
+descriptors (DSC), the stored macro (MAC), the device status (ST) and the bus suspend (SUS),
+remote wakeup (RWK) and resume (RES) events.
+
+  usage: sfcpad_sim [-l loop_us] [-p poll_us] [-f hef.bin] [-m macro.bin] trace
+
+Trace lines are "<time ms> <command> [args]" in time order, '#' starts a
+comment.  Commands at time 0 are applied before plug-in, so a button
+pressed at 0 is held while the personality is chosen.
+  press <button>...             A B X Y L R SELECT START UP DOWN LEFT RIGHT
+  release <button>...
+  set_idle <rate>               HID SET_IDLE on interface 0 (4ms units)
+  get_feature                   mapping GET_REPORT, prints FR
+  set_feature <off>=<val>...    read-modify-write of the mapping report
+  set_tag <tag> <val>...        tag SET_REPORT (<tag> with the length nibble)
+  get_tag <type>                selects and reads a mapping tag, prints TAG
+  map_cmd [<op> <arg>...]       mapping command SET_REPORT, prints CMD
+                                (without <op> only the report ID is sent)
+  set_report <id> <len> [<byte>...]
+                                SET_REPORT of <len> bytes on interface 1,
+                                the report ID and the bytes given; prints
+                                STALL if the device refuses it
+  get_latency                   latency GET_REPORT, prints LAT
+  reset_latency                 latency SET_REPORT (clears the statistics)
+  dump_macro                    prints the stored macro as MAC runs
+  quiet on|off                  leaves the TX / IN / AGE lines out
+  cadence                       prints CAD: host pickups and the longest
+                                gap between them since the last cadence
+  suspend                       host suspends the bus
+  resume                        host resumes the bus
+  remote_wakeup on|off          SET / CLEAR_FEATURE(DEVICE_REMOTE_WAKEUP)
+  get_status                    device GET_STATUS, prints ST
+  get_descriptor device|config  GET_DESCRIPTOR, prints DSC
+  end                           stop the run
+*******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "system.h"
+#include "usb.h"
+#include "usb_device_hid.h"
+#include "app_device_joystick.h"
+#include "mapping.h"
+#include "usb_personality.h"
+#include "latency.h"
+#include "macro.h"
+#include "macro_codec.h"
+#include "sim.h"
+
+#define LINE_MAX_LEN    256
+
+static const struct {
+    const char *name;
+    uint16_t snap;
+} buttonNames[] = {
+    { "A",      BUTTON_SNAP_A },
+    { "B",      BUTTON_SNAP_B },
+    { "X",      BUTTON_SNAP_X },
+    { "Y",      BUTTON_SNAP_Y },
+    { "L",      BUTTON_SNAP_TL },
+    { "R",      BUTTON_SNAP_TR },
+    { "SELECT", BUTTON_SNAP_SELECT },
+    { "START",  BUTTON_SNAP_START },
+    { "UP",     BUTTON_SNAP_UP },
+    { "DOWN",   BUTTON_SNAP_DOWN },
+    { "LEFT",   BUTTON_SNAP_LEFT },
+    { "RIGHT",  BUTTON_SNAP_RIGHT }
+};
+
+static uint16_t pressed;            // BUTTON_SNAP_* bits held
+static FILE *trace;
+static unsigned lineNo;
+static uint32_t cmdTimeUs;          // time of the pending command
+static char cmdLine[LINE_MAX_LEN];  // pending command (after the time)
+static bool cmdPending;
+static const char *flashPath;
+static const char *macroPath;
+
+/**
+ * Print an error for the current trace line and exit
+ * @param msg Message
+ */
+static void TraceError(const char *msg) {
+    fprintf(stderr, "trace:%u: %s\n", lineNo, msg);
+    exit(2);
+}
+
+/**
+ * Read the next command of the trace
+ * @return false at the end of the trace
+ */
+static bool TraceNext(void) {
+    char line[LINE_MAX_LEN];
+
+    while (fgets(line, sizeof(line), trace) != NULL) {
+        char *p = line;
+        char *end;
+        double ms;
+
+        lineNo++;
+        if ((end = strchr(p, '#')) != NULL) *end = '\0';
+        while (isspace((unsigned char)*p)) p++;
+        if (*p == '\0') continue;
+
+        ms = strtod(p, &end);
+        if (end == p || ms < 0) TraceError("time expected");
+        if ((uint32_t)(ms * 1000.0 + 0.5) < cmdTimeUs) TraceError("time goes backwards");
+        cmdTimeUs = (uint32_t)(ms * 1000.0 + 0.5);
+        strncpy(cmdLine, end, sizeof(cmdLine) - 1);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Parse a list of button names
+ * @return BUTTON_SNAP_* bits
+ */
+static uint16_t ParseButtons(void) {
+    uint16_t snap = 0;
+    char *tok;
+
+    while ((tok = strtok(NULL, " \t\r\n")) != NULL) {
+        size_t i;
+        for (i = 0; i < sizeof(buttonNames) / sizeof(buttonNames[0]); i++) {
+            if (strcmp(tok, buttonNames[i].name) == 0) break;
+        }
+        if (i == sizeof(buttonNames) / sizeof(buttonNames[0])) TraceError("unknown button");
+        snap |= buttonNames[i].snap;
+    }
+    return snap;
+}
+
+/**
+ * Read the mapping feature report through GET_REPORT
+ * @param buf 64 byte buffer
+ */
+static void GetFeature(uint8_t *buf) {
+    static const uint8_t setup[8] = { 0xA1, GET_REPORT, MAP_REPORT_ID, 0x03, 0x01, 0x00, HID_MAP_EP_BUF_SIZE, 0x00 };
+
+    if (SIM_USBControl(setup, buf) != HID_MAP_EP_BUF_SIZE) TraceError("GET_REPORT failed");
+}
+
+/**
+ * Send the remaining trace arguments as a tag SET_REPORT
+ * @param buf 64 byte buffer
+ */
+static void SetTag(uint8_t *buf) {
+    uint8_t setup[8] = { 0x21, SET_REPORT, MAP_TAG_REPORT_ID, 0x03, 0x01, 0x00, 0x00, 0x00 };
+    uint8_t len = 1;
+    char *tok;
+
+    buf[0] = MAP_TAG_REPORT_ID;
+    while ((tok = strtok(NULL, " \t\r\n")) != NULL) {
+        if (len == HID_MAP_EP_BUF_SIZE) TraceError("too many values");
+        buf[len++] = (uint8_t)strtoul(tok, NULL, 0);
+    }
+    if (len < 2) TraceError("tag expected");
+    setup[6] = len;                     // only the tag is sent
+    SIM_USBControl(setup, buf);
+}
+
+/**
+ * Select a tag type, read it through GET_REPORT and print it
+ * @param buf 64 byte buffer
+ */
+static void GetTag(uint8_t *buf) {
+    static const uint8_t get[8] = { 0xA1, GET_REPORT, MAP_TAG_REPORT_ID, 0x03, 0x01, 0x00, HID_MAP_EP_BUF_SIZE, 0x00 };
+    uint8_t setup[8] = { 0x21, SET_REPORT, MAP_TAG_REPORT_ID, 0x03, 0x01, 0x00, 2, 0x00 };
+    char *arg = strtok(NULL, " \t\r\n");
+    int len;
+
+    if (arg == NULL) TraceError("tag type expected");
+    buf[0] = MAP_TAG_REPORT_ID;
+    buf[1] = MAP_TAG((uint8_t)strtoul(arg, NULL, 0) & 0x0F, 0);
+    SIM_USBControl(setup, buf);
+    if ((len = SIM_USBControl(get, buf)) < 2 || buf[0] != MAP_TAG_REPORT_ID) TraceError("tag GET_REPORT failed");
+
+    fprintf(simOut, "%9lu TAG", (unsigned long)simTimeUs);
+    for (int i = 1; i < len; i++) fprintf(simOut, " %02X", buf[i]);
+    fputc('\n', simOut);
+}
+
+/**
+ * Send the remaining trace arguments as a mapping command, read the result
+ * back and print it
+ * @param buf 64 byte buffer
+ */
+static void MapCommand(uint8_t *buf) {
+    static const uint8_t get[8] = { 0xA1, GET_REPORT, MAP_CMD_REPORT_ID, 0x03, 0x01, 0x00, HID_MAP_EP_BUF_SIZE, 0x00 };
+    uint8_t setup[8] = { 0x21, SET_REPORT, MAP_CMD_REPORT_ID, 0x03, 0x01, 0x00, 0x00, 0x00 };
+    uint8_t len = 1;
+    char *tok;
+
+    buf[0] = MAP_CMD_REPORT_ID;
+    while ((tok = strtok(NULL, " \t\r\n")) != NULL) {
+        if (len == HID_MAP_EP_BUF_SIZE) TraceError("too many arguments");
+        buf[len++] = (uint8_t)strtoul(tok, NULL, 0);
+    }
+    setup[6] = len;                     // only the command is sent
+    SIM_USBControl(setup, buf);
+    if (SIM_USBControl(get, buf) != MAP_CMD_RESULT_LEN || buf[0] != MAP_CMD_REPORT_ID) {
+        TraceError("command GET_REPORT failed");
+    }
+    fprintf(simOut, "%9lu CMD %02X %02X %02X\n", (unsigned long)simTimeUs, buf[1], buf[2], buf[3]);
+}
+
+/**
+ * Read the latency statistics through GET_REPORT and print them decoded:
+ * edge count, min/max/avg of sample->arm, arm->pickup and total, histogram,
+ * wake-ups and last/max wake-up -> first report
+ */
+static void GetLatency(void) {
+    static const uint8_t setup[8] = { 0xA1, GET_REPORT, LATENCY_REPORT_ID, 0x03, 0x01, 0x00, HID_MAP_EP_BUF_SIZE, 0x00 };
+    static const char *const names[] = { "arm", "pickup", "total" };
+    uint8_t buf[HID_MAP_EP_BUF_SIZE];
+    const uint8_t *p = buf + 4;
+
+    if (SIM_USBControl(setup, buf) != HID_MAP_EP_BUF_SIZE || buf[0] != LATENCY_REPORT_ID) {
+        TraceError("latency GET_REPORT failed");
+    }
+    fprintf(simOut, "%9lu LAT edges %u", (unsigned long)simTimeUs, buf[2] | (buf[3] << 8));
+    for (uint8_t i = 0; i < 3; i++, p += 6) {
+        fprintf(simOut, " %s %u/%u/%u", names[i],
+                p[0] | (p[1] << 8), p[2] | (p[3] << 8), p[4] | (p[5] << 8));
+    }
+    fprintf(simOut, " hist");
+    for (uint8_t i = 0; i < LATENCY_HIST_BINS; i++, p += 2) {
+        fprintf(simOut, " %u", p[0] | (p[1] << 8));
+    }
+    fprintf(simOut, " wake %u %lu/%lu\n", p[0] | (p[1] << 8),
+            (unsigned long)(p[2] | (p[3] << 8) | ((uint32_t)p[4] << 16) | ((uint32_t)p[5] << 24)),
+            (unsigned long)(p[6] | (p[7] << 8) | ((uint32_t)p[8] << 16) | ((uint32_t)p[9] << 24)));
+}
+
+/**
+ * Decode the macro area and print one MAC line per run
+ */
+static void DumpMacro(void) {
+    static MACRO_RUN runs[MACRO_STEPS];
+    int n;
+
+    if ((n = MacroCodec_Decode(macroSteps, macroLength, runs, MACRO_STEPS)) < 0) {
+        fprintf(simOut, "%9lu MAC none\n", (unsigned long)simTimeUs);
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        fprintf(simOut, "%9lu MAC ", (unsigned long)simTimeUs);
+        MacroCodec_PrintRun(simOut, &runs[i]);
+        fputc('\n', simOut);
+    }
+}
+
+/**
+ * Run one trace command
+ * @return false on "end"
+ */
+static bool TraceRun(void) {
+    char *cmd = strtok(cmdLine, " \t\r\n");
+    uint8_t buf[HID_MAP_EP_BUF_SIZE];
+
+    if (strcmp(cmd, "press") == 0) {
+        pressed |= ParseButtons();
+        SIM_SetButtons(pressed);
+    } else if (strcmp(cmd, "release") == 0) {
+        pressed &= (uint16_t)~ParseButtons();
+        SIM_SetButtons(pressed);
+    } else if (strcmp(cmd, "set_idle") == 0) {
+        char *arg = strtok(NULL, " \t\r\n");
+        uint8_t setup[8] = { 0x21, SET_IDLE, 0x00, 0x00, HID_INTF_ID, 0x00, 0x00, 0x00 };
+
+        if (arg == NULL) TraceError("idle rate expected");
+        setup[3] = (uint8_t)strtoul(arg, NULL, 0);
+        SIM_USBControl(setup, buf);
+    } else if (strcmp(cmd, "get_feature") == 0) {
+        GetFeature(buf);
+        fprintf(simOut, "%9lu FR ", (unsigned long)simTimeUs);
+        for (uint8_t i = 0; i < sizeof(buf); i++) fprintf(simOut, " %02X", buf[i]);
+        fputc('\n', simOut);
+    } else if (strcmp(cmd, "set_feature") == 0) {
+        static const uint8_t setup[8] = { 0x21, SET_REPORT, MAP_REPORT_ID, 0x03, 0x01, 0x00, HID_MAP_EP_BUF_SIZE, 0x00 };
+        char *tok;
+
+        GetFeature(buf);
+        while ((tok = strtok(NULL, " \t\r\n")) != NULL) {
+            char *eq = strchr(tok, '=');
+            unsigned long off;
+
+            if (eq == NULL) TraceError("<offset>=<value> expected");
+            off = strtoul(tok, NULL, 0);
+            if (off >= sizeof(buf)) TraceError("offset out of range");
+            buf[off] = (uint8_t)strtoul(eq + 1, NULL, 0);
+        }
+        SIM_USBControl(setup, buf);
+    } else if (strcmp(cmd, "set_tag") == 0) {
+        SetTag(buf);
+    } else if (strcmp(cmd, "get_tag") == 0) {
+        GetTag(buf);
+    } else if (strcmp(cmd, "map_cmd") == 0) {
+        MapCommand(buf);
+    } else if (strcmp(cmd, "set_report") == 0) {
+        uint8_t setup[8] = { 0x21, SET_REPORT, 0x00, 0x03, 0x01, 0x00, 0x00, 0x00 };
+        char *id = strtok(NULL, " \t\r\n");
+        char *len = strtok(NULL, " \t\r\n");
+        char *arg;
+        uint8_t n = 1;
+
+        if (id == NULL || len == NULL) TraceError("report ID and length expected");
+        memset(buf, 0, sizeof(buf));
+        buf[0] = setup[2] = (uint8_t)strtoul(id, NULL, 0);
+        setup[6] = (uint8_t)strtoul(len, NULL, 0);
+        while ((arg = strtok(NULL, " \t\r\n")) != NULL) {
+            if (n == HID_MAP_EP_BUF_SIZE) TraceError("too many values");
+            buf[n++] = (uint8_t)strtoul(arg, NULL, 0);
+        }
+        if (SIM_USBControl(setup, buf) < 0) fprintf(simOut, "%9lu STALL\n", (unsigned long)simTimeUs);
+    } else if (strcmp(cmd, "get_latency") == 0) {
+        GetLatency();
+    } else if (strcmp(cmd, "reset_latency") == 0) {
+        static const uint8_t setup[8] = { 0x21, SET_REPORT, LATENCY_REPORT_ID, 0x03, 0x01, 0x00, HID_MAP_EP_BUF_SIZE, 0x00 };
+
+        memset(buf, 0, sizeof(buf));
+        buf[0] = LATENCY_REPORT_ID;
+        SIM_USBControl(setup, buf);
+    } else if (strcmp(cmd, "dump_macro") == 0) {
+        DumpMacro();
+    } else if (strcmp(cmd, "quiet") == 0) {
+        char *arg = strtok(NULL, " \t\r\n");
+
+        if (arg == NULL || (strcmp(arg, "on") != 0 && strcmp(arg, "off") != 0)) TraceError("on or off expected");
+        simQuiet = (strcmp(arg, "on") == 0);
+    } else if (strcmp(cmd, "cadence") == 0) {
+        uint32_t maxGapUs;
+        uint32_t count = SIM_USBCadence(&maxGapUs);
+
+        fprintf(simOut, "%9lu CAD %lu max %lu\n", (unsigned long)simTimeUs, (unsigned long)count, (unsigned long)maxGapUs);
+    } else if (strcmp(cmd, "suspend") == 0) {
+        SIM_USBSuspend();
+    } else if (strcmp(cmd, "resume") == 0) {
+        SIM_USBResume();
+    } else if (strcmp(cmd, "remote_wakeup") == 0) {
+        char *arg = strtok(NULL, " \t\r\n");
+        uint8_t setup[8] = { 0x00, USB_REQUEST_SET_FEATURE, USB_FEATURE_DEVICE_REMOTE_WAKEUP, 0x00, 0x00, 0x00, 0x00, 0x00 };
+
+        if (arg == NULL || (strcmp(arg, "on") != 0 && strcmp(arg, "off") != 0)) TraceError("on or off expected");
+        if (strcmp(arg, "off") == 0) setup[1] = USB_REQUEST_CLEAR_FEATURE;
+        if (SIM_USBControl(setup, buf) < 0) fprintf(simOut, "%9lu STALL\n", (unsigned long)simTimeUs);
+    } else if (strcmp(cmd, "get_status") == 0) {
+        static const uint8_t setup[8] = { 0x80, USB_REQUEST_GET_STATUS, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00 };
+
+        if (SIM_USBControl(setup, buf) != 2) TraceError("GET_STATUS failed");
+        fprintf(simOut, "%9lu ST  %02X %02X\n", (unsigned long)simTimeUs, buf[0], buf[1]);
+    } else if (strcmp(cmd, "get_descriptor") == 0) {
+        char *arg = strtok(NULL, " \t\r\n");
+        uint8_t setup[8] = { 0x80, USB_REQUEST_GET_DESCRIPTOR, 0x00, USB_DESCRIPTOR_DEVICE, 0x00, 0x00, sizeof(buf), 0x00 };
+        int len;
+
+        if (arg == NULL || (strcmp(arg, "device") != 0 && strcmp(arg, "config") != 0)) TraceError("device or config expected");
+        if (strcmp(arg, "config") == 0) setup[3] = USB_DESCRIPTOR_CONFIGURATION;
+        if ((len = SIM_USBControl(setup, buf)) < 0) TraceError("GET_DESCRIPTOR failed");
+        fprintf(simOut, "%9lu DSC", (unsigned long)simTimeUs);
+        for (int i = 0; i < len; i++) fprintf(simOut, " %02X", buf[i]);
+        fputc('\n', simOut);
+    } else if (strcmp(cmd, "end") == 0) {
+        return false;
+    } else {
+        TraceError("unknown command");
+    }
+    return true;
+}
+
+/**
+ * Run the trace commands that are due
+ * Clears cmdPending at the end of the trace.
+ */
+static void TraceTasks(void) {
+    while (cmdPending && cmdTimeUs <= simTimeUs) {
+        if (!TraceRun()) {
+            cmdPending = false;
+            break;
+        }
+        cmdPending = TraceNext();
+    }
+}
+
+/**
+ * Print the flash summary and save the images
+ * @return Exit status
+ */
+static int Finish(void) {
+    fprintf(simOut, "# flash erases %u writes %u\n", simFlashErases, simFlashWrites);
+    fclose(trace);
+    if (flashPath != NULL && !SIM_FlashSave(flashPath)) {
+        perror(flashPath);
+        return 1;
+    }
+    if (macroPath != NULL && !MacroCodec_Save(macroPath, macroSteps, macroLength)) {
+        perror(macroPath);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Trace player run while the firmware sleeps in SLEEP()
+ */
+static void SleepTask(void) {
+    TraceTasks();
+    if (!cmdPending) exit(Finish());    // the trace ended in the sleep
+}
+
+int main(int argc, char **argv) {
+    uint32_t loopUs = 50;
+    int i;
+
+    simOut = stdout;
+    for (i = 1; i < argc - 1 && argv[i][0] == '-'; i += 2) {
+        if (strcmp(argv[i], "-l") == 0) {
+            loopUs = (uint32_t)strtoul(argv[i + 1], NULL, 0);
+        } else if (strcmp(argv[i], "-p") == 0) {
+            SIM_USBSetPollPhase((uint32_t)strtoul(argv[i + 1], NULL, 0));
+        } else if (strcmp(argv[i], "-f") == 0) {
+            flashPath = argv[i + 1];
+        } else if (strcmp(argv[i], "-m") == 0) {
+            macroPath = argv[i + 1];
+        } else {
+            break;
+        }
+    }
+    if (i != argc - 1 || loopUs == 0) {
+        fprintf(stderr, "usage: %s [-l loop_us] [-p poll_us] [-f hef.bin] [-m macro.bin] trace\n", argv[0]);
+        return 2;
+    }
+    if ((trace = fopen(argv[i], "r")) == NULL) {
+        perror(argv[i]);
+        return 2;
+    }
+    if (flashPath != NULL) SIM_FlashLoad(flashPath);
+    if (macroPath != NULL) MacroCodec_Load(macroPath, macroSteps, &macroLength);
+
+    // Buttons held at plug-in
+    SIM_SetButtons(0);
+    cmdPending = TraceNext();
+    while (cmdPending && cmdTimeUs == 0 && strncmp(cmdLine + strspn(cmdLine, " \t"), "press", 5) == 0) {
+        TraceRun();
+        cmdPending = TraceNext();
+    }
+
+    // Same order as main(): clock, mapping, personality, then enumeration
+    SYSTEM_Initialize(SYSTEM_STATE_USB_START);
+    Mapping_Load();
+    USBPersonalitySelect(Mapping_GetPersonality(), BUTTON_Snapshot());
+    SIM_USBConfigure();
+
+    simSleepTask = SleepTask;
+    while (1) {
+        TraceTasks();
+        if (!cmdPending) break;
+
+#if defined(USB_POLLING)
+        SIM_USBTasks();                 // as main(); the ISR does it otherwise
+#endif
+        if (USBGetDeviceState() >= CONFIGURED_STATE) {
+            if (!USBIsDeviceSuspended()) {
+                APP_DeviceJoystickTasks();
+            } else if (SYSTEM_ButtonWake()) {
+                USBCBSendResume();      // as main(): remote wakeup after a button wake-up
+            }
+        }
+        SIM_AdvanceTo(simTimeUs + loopUs);
+    }
+    return Finish();
+}
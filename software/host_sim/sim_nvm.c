@@ -0,0 +1,149 @@
+/*******************************************************************************
+Copyright 2025 Custom USB Gamepad Project
+
+Simulated NVM driver: same API as mcc_generated_files/nvm/src/nvm.c over
+a flash array in host memory
+*******************************************************************************/
+
+#include <string.h>
+#include "mcc_generated_files/nvm/nvm.h"
+#include "sim.h"
+
+#define HEF_ADDR    0x1F80
+#define HEF_WORDS   (PROGMEM_SIZE - HEF_ADDR)
+
+static flash_data_t flash[PROGMEM_SIZE];
+static bool flashErased;
+static uint16_t unlockKey;
+
+uint16_t simFlashErases;
+uint16_t simFlashWrites;
+
+/**
+ * Erase the whole program memory on first use
+ */
+static void FlashInit(void) {
+    if (flashErased) return;
+    for (uint16_t i = 0; i < PROGMEM_SIZE; i++) flash[i] = 0x3FFF;
+    flashErased = true;
+}
+
+/**
+ * Check the unlock key like the PMCON2 sequence does
+ * @return true if a write or erase may start
+ */
+static bool FlashUnlocked(void) {
+    if (unlockKey == UNLOCK_KEY) return true;
+    PMCON1bits.WRERR = 1;
+    return false;
+}
+
+void NVM_Initialize(void) {
+    NVM_StatusClear();
+}
+
+bool NVM_IsBusy(void) {
+    return false;       // erase and write complete inside the call
+}
+
+nvm_status_t NVM_StatusGet(void) {
+    return PMCON1bits.WRERR ? NVM_ERROR : NVM_OK;
+}
+
+void NVM_StatusClear(void) {
+    PMCON1bits.WRERR = 0;
+}
+
+void NVM_UnlockKeySet(uint16_t key) {
+    unlockKey = key;
+}
+
+void NVM_UnlockKeyClear(void) {
+    unlockKey = 0;
+}
+
+flash_data_t FLASH_Read(flash_address_t address) {
+    FlashInit();
+    return flash[address % PROGMEM_SIZE];
+}
+
+nvm_status_t FLASH_RowWrite(flash_address_t address, flash_data_t *dataBuffer) {
+    FlashInit();
+    if (!FlashUnlocked()) return NVM_ERROR;
+
+    address = FLASH_PageAddressGet(address);
+    for (uint8_t i = 0; i < PROGMEM_PAGE_SIZE; i++) {
+        // programming can only clear bits
+        flash[address + i] &= (flash_data_t)(dataBuffer[i] & 0x3FFF);
+    }
+    simFlashWrites++;
+    return NVM_OK;
+}
+
+nvm_status_t FLASH_PageErase(flash_address_t address) {
+    FlashInit();
+    if (!FlashUnlocked()) return NVM_ERROR;
+
+    address = FLASH_PageAddressGet(address);
+    for (uint8_t i = 0; i < PROGMEM_PAGE_SIZE; i++) {
+        flash[address + i] = 0x3FFF;
+    }
+    simFlashErases++;
+    return NVM_OK;
+}
+
+flash_address_t FLASH_PageAddressGet(flash_address_t address) {
+    return (flash_address_t)((address % PROGMEM_SIZE) & ~(PROGMEM_PAGE_SIZE - 1U));
+}
+
+uint16_t FLASH_PageOffsetGet(flash_address_t address) {
+    return (uint16_t)(address & (PROGMEM_PAGE_SIZE - 1U));
+}
+
+/**
+ * Load / save 14 bit words
+ * @param path Binary file of the words (little endian)
+ * @param words Words to fill / save
+ * @param n Number of words (at most PROGMEM_SIZE)
+ * @return true on success
+ */
+static bool WordsLoad(const char *path, uint16_t *words, uint16_t n) {
+    uint8_t buf[PROGMEM_SIZE * 2];
+    FILE *f = fopen(path, "rb");
+
+    if (f == NULL) return false;
+    if (fread(buf, 1, n * 2u, f) != n * 2u) {
+        fclose(f);
+        return false;
+    }
+    fclose(f);
+    for (uint16_t i = 0; i < n; i++) {
+        words[i] = (uint16_t)((buf[2 * i] | (buf[2 * i + 1] << 8)) & 0x3FFF);
+    }
+    return true;
+}
+
+static bool WordsSave(const char *path, const uint16_t *words, uint16_t n) {
+    uint8_t buf[PROGMEM_SIZE * 2];
+    FILE *f = fopen(path, "wb");
+    bool ok;
+
+    if (f == NULL) return false;
+    for (uint16_t i = 0; i < n; i++) {
+        buf[2 * i] = (uint8_t)words[i];
+        buf[2 * i + 1] = (uint8_t)(words[i] >> 8);
+    }
+    ok = fwrite(buf, 1, n * 2u, f) == n * 2u;
+    fclose(f);
+    return ok;
+}
+
+bool SIM_FlashLoad(const char *path) {
+    FlashInit();
+    return WordsLoad(path, &flash[HEF_ADDR], HEF_WORDS);
+}
+
+bool SIM_FlashSave(const char *path) {
+    FlashInit();
+    return WordsSave(path, &flash[HEF_ADDR], HEF_WORDS);
+}
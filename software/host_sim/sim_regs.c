@@ -0,0 +1,66 @@
+/*******************************************************************************
+Copyright 2025 Custom USB Gamepad Project
+
+Simulated PIC16F1459 register file (see include/xc.h)
+*******************************************************************************/
+
+#include <xc.h>
+#include "sim.h"
+
+/* Buttons are active low with pull-ups: all released at reset */
+volatile uint8_t PORTA = 0xFF;
+volatile uint8_t PORTB = 0xFF;
+volatile uint8_t PORTC = 0xFF;
+volatile uint8_t TRISA = 0xFF;
+volatile uint8_t TRISB = 0xFF;
+volatile uint8_t TRISC = 0xFF;
+volatile uint8_t WPUA;
+volatile uint8_t WPUB;
+volatile uint8_t ANSELA;
+volatile uint8_t ANSELB;
+volatile uint8_t ANSELC;
+
+volatile uint8_t IOCAN;
+volatile uint8_t IOCAF;
+volatile uint8_t IOCBN;
+volatile uint8_t IOCBF;
+
+volatile uint8_t OSCCON;
+volatile uint8_t OSCSTAT;           // PLLRDY follows OSCCON (sim_usb.c)
+volatile uint8_t ACTCON;
+volatile uint8_t WDTCON;
+
+volatile uint8_t OPTION_REG;
+volatile uint8_t TMR0;
+volatile uint8_t T1CON;
+volatile uint8_t TMR1L;
+volatile uint8_t TMR1H;
+volatile uint8_t INTCON;
+volatile uint8_t PIR1;
+volatile uint8_t PIE2;
+volatile uint8_t PIR2;
+
+volatile uint8_t PMCON1;
+volatile uint8_t PMCON2;
+volatile uint8_t PMADRL;
+volatile uint8_t PMADRH;
+volatile uint8_t PMDATL;
+volatile uint8_t PMDATH;
+
+volatile uint8_t UCON;
+volatile uint8_t UIR;
+volatile uint8_t UIE;
+
+void SIM_SetButtons(uint16_t snap) {
+    uint8_t a = PORTA;
+    uint8_t b = PORTB;
+
+    // buttons are active low (see io_mapping.h for the pins)
+    PORTA = (uint8_t)~((snap >> 4) & 0x30);
+    PORTB = (uint8_t)~((snap >> 8) & 0xF0);
+    PORTC = (uint8_t)~(snap & 0xFC);
+
+    // interrupt-on-change, negative edge
+    IOCAF |= (uint8_t)(a & ~PORTA & IOCAN);
+    IOCBF |= (uint8_t)(b & ~PORTB & IOCBN);
+}
@@ -0,0 +1,503 @@
+/*******************************************************************************
+Copyright 2025 Custom USB Gamepad Project
+
+Simulated USB device layer and host
+
+Stands in for usb_device.c and the SIE: it owns the device state, the EP0
+pipes and the EP1 IN ping-pong buffer descriptors.  The host polls EP1
+once per frame at a fixed phase after SOF and picks up the report armed
+on the next BDT in even / odd order; the SOF
+and transfer complete events reach the firmware the next time
+USBDeviceTasks() would run, as in USB_POLLING mode.
+
+The host can suspend the bus (no SOF, no polls).  After 3ms of idle the
+device layer calls USBSuspend(), and the firmware sleeps in SIM_Sleep()
+until a wake-up source fires.  USBSuspend(), USBWakeFromSuspend() and
+USBCBSendResume() are the firmware's own (usb_device_suspend.c): the K-state
+starts when UCON.RESUME is set.  Resume signalling, from the host or as a
+remote wakeup, lasts 20ms; the host then restarts the SOFs and polls EP1
+again after the 10ms resume recovery time.  The 48MHz PLL locks
+SIM_PLL_LOCK_US after OSCCON.SPLLEN is set, and a CLK line flags the USB
+module leaving suspend before that.
+
+In a USB_INTERRUPT build the events reach the firmware through its ISR
+(SYS_InterruptHigh() -> USBDeviceTasks()) as soon as they are raised,
+unless the USB interrupt is masked or GIE is clear.
+*******************************************************************************/
+
+#include <string.h>
+#include "system.h"
+#include "usb.h"
+#include "usb_device_hid.h"
+#include "sim.h"
+
+/* Device layer state normally defined in usb_device.c */
+USB_VOLATILE USB_DEVICE_STATE USBDeviceState = DETACHED_STATE;
+USB_VOLATILE uint8_t USBActiveConfiguration;
+USB_VOLATILE IN_PIPE inPipes[1];
+USB_VOLATILE OUT_PIPE outPipes[1];
+volatile CTRL_TRF_SETUP SetupPkt;
+USB_VOLATILE bool RemoteWakeup;
+USB_VOLATILE bool USBBusIsSuspended;
+USB_VOLATILE uint8_t USBTicksSinceSuspendEnd;
+
+#define SIM_IDLE_US         3000u   // bus idle until the SIE flags IDLEIF
+#define SIM_RESUME_US       20000u  // resume signalling driven by the host
+#define SIM_RECOVERY_US     10000u  // resume recovery, no transactions
+#define SIM_PLL_LOCK_US     2000u   // SPLLEN set -> PLLRDY (assumed)
+#define SIM_PLL_POLL_US     1u      // one pass of the PLLRDY wait loop
+#define SIM_SLEEP_STEP_US   50u
+#define SIM_T1_TICK_US      32u     // Timer1 on LFINTOSC
+
+enum {
+    BUS_RUNNING = 0,
+    BUS_SUSPENDED,                  // host stopped the SOFs
+    BUS_RESUMING                    // resume signalling until busUpUs
+};
+
+uint32_t simTimeUs;
+FILE *simOut;
+bool simQuiet;
+void (*simSleepTask)(void);
+
+static uint32_t tick1ms;            // USBGet1msTickCount()
+static uint32_t lastFrame;          // frame number of simTimeUs
+static uint32_t lastTmr0Count;      // Timer0 increments since plug-in
+static bool sofPending;
+static bool transferPending;        // EP1 IN transaction complete, not yet delivered
+static uint8_t transferBdt;         // BDT of that transaction
+static uint32_t pollPhaseUs = 500;
+static uint8_t busState = BUS_RUNNING;
+static uint32_t busIdleUs;          // time the host stopped the SOFs
+static uint32_t busUpUs;            // time the resume signalling ends
+static uint32_t pollUpUs;           // first host poll after a resume
+static bool idleSeen;               // IDLEIF raised for this idle period
+static bool idlePending;            // IDLEIF, not yet delivered
+static uint32_t t1Frac;             // Timer1 us not counted yet
+static uint32_t pollCount;          // pickups since SIM_USBCadence()
+static uint32_t pollLastUs;         // time of the last pickup
+static uint32_t pollMaxGapUs;
+static bool pllOn = true;           // SPLLEN seen set (locked at reset)
+static bool pllLocked = true;
+static uint32_t pllOnUs;            // time SPLLEN was seen set
+static bool usbSuspended;           // SUSPND seen set, not cleared yet
+
+static uint8_t epEnabled[USB_MAX_EP_NUMBER + 1];
+static volatile BDT_ENTRY ep1In[2]; // EP1 IN buffer descriptors (even, odd)
+static uint8_t *ep1Buf[2];          // buffer the SIE reads at pickup
+static uint32_t ep1ArmedUs[2];
+static uint8_t ep1Next;             // BDT the firmware arms next (pBDTEntryIn[1])
+static uint8_t ep1HostNext;         // BDT the SIE sends next
+
+extern bool USER_USB_CALLBACK_EVENT_HANDLER(USB_EVENT event, void *pdata, uint16_t size);
+extern void SYS_InterruptHigh(void);
+extern void USBSuspend(void);           // usb_device_suspend.c
+extern void USBWakeFromSuspend(void);
+
+/**
+ * Print a time stamped packet
+ * @param tag Line tag
+ * @param data Packet
+ * @param len Packet length
+ */
+static void SimPrintPacket(const char *tag, const uint8_t *data, uint16_t len) {
+    if (simOut == NULL || simQuiet) return;
+    fprintf(simOut, "%9lu %-3s", (unsigned long)simTimeUs, tag);
+    for (uint16_t i = 0; i < len; i++) fprintf(simOut, " %02X", data[i]);
+    fputc('\n', simOut);
+}
+
+/**
+ * Host IN token on EP1: the SIE sends the buffer and releases the BDT
+ */
+static void SimHostPoll(void) {
+    volatile BDT_ENTRY *bd = &ep1In[ep1HostNext];
+
+    if (!bd->STAT.UOWN) return;
+
+    SimPrintPacket("IN", ep1Buf[ep1HostNext], bd->CNT);
+    if (simOut != NULL && !simQuiet) {
+        fprintf(simOut, "%9lu AGE %lu\n", (unsigned long)simTimeUs,
+                (unsigned long)(simTimeUs - ep1ArmedUs[ep1HostNext]));
+    }
+    if (pollLastUs != 0 && simTimeUs - pollLastUs > pollMaxGapUs) pollMaxGapUs = simTimeUs - pollLastUs;
+    pollLastUs = simTimeUs;
+    pollCount++;
+    bd->STAT.UOWN = 0;
+    transferPending = true;
+    transferBdt = ep1HostNext;
+    ep1HostNext ^= 1;
+}
+
+/**
+ * USB interrupt: run the firmware ISR if an event is pending and the
+ * interrupt is enabled (USB_INTERRUPT builds only)
+ */
+static void SimUSBInterrupt(void) {
+#if defined(USB_INTERRUPT)
+    if (!INTCONbits.GIE || !INTCONbits.PEIE || !PIE2bits.USBIE) return;
+    if (!sofPending && !transferPending && !idlePending && !(UIRbits.ACTVIF && UIEbits.ACTVIE)) return;
+
+    INTCONbits.GIE = 0;             // cleared on entry, set again by RETFIE
+    SYS_InterruptHigh();
+    INTCONbits.GIE = 1;
+#endif
+}
+
+/**
+ * Start the resume signalling on a suspended bus
+ */
+static void SimBusResume(void) {
+    if (busState != BUS_SUSPENDED) return;
+
+    busState = BUS_RESUMING;
+    busUpUs = simTimeUs + SIM_RESUME_US;
+    UIRbits.ACTVIF = 1;
+}
+
+/**
+ * Update PLLRDY from OSCCON.SPLLEN and check that the USB module only
+ * leaves suspend with the PLL locked
+ */
+static void SimClock(void) {
+    if ((OSCCON & 0x80) == 0) {
+        pllOn = false;
+        pllLocked = false;
+    } else if (!pllOn) {
+        pllOn = true;
+        pllOnUs = simTimeUs;
+    } else if (!pllLocked && simTimeUs - pllOnUs >= SIM_PLL_LOCK_US) {
+        pllLocked = true;
+    }
+    if (pllLocked) {
+        OSCSTAT |= 0x40;
+    } else {
+        OSCSTAT &= (uint8_t)~0x40;
+    }
+
+    if (UCONbits.SUSPND) {
+        usbSuspended = true;
+    } else if (usbSuspended) {
+        usbSuspended = false;
+        if (!pllLocked && simOut != NULL) fprintf(simOut, "%9lu CLK SUSPND cleared before PLLRDY\n", (unsigned long)simTimeUs);
+    }
+}
+
+/**
+ * Advance Timer0 and Timer1 by the time since the last call
+ * @param from Time of the last call
+ */
+static void SimTimers(uint32_t from) {
+    uint32_t count;
+
+    // Timer1 on LFINTOSC (latency.c times wake-ups with it)
+    if (T1CONbits.TMR1ON) {
+        uint32_t ticks;
+
+        t1Frac += simTimeUs - from;
+        ticks = t1Frac / SIM_T1_TICK_US;
+        t1Frac %= SIM_T1_TICK_US;
+        count = (uint32_t)((TMR1H << 8) | TMR1L) + ticks;
+        if (count > 0xFFFF) PIR1bits.TMR1IF = 1;
+        TMR1H = (uint8_t)(count >> 8);
+        TMR1L = (uint8_t)count;
+    } else {
+        t1Frac = 0;
+    }
+
+    // Timer0: Fcy / 256, the overflow flag stays set until the firmware clears it
+    count = (uint32_t)((uint64_t)simTimeUs * (SIM_FOSC_HZ / 4 / 1000) / 1000 / SIM_TMR0_PS);
+    if ((count >> 8) != (lastTmr0Count >> 8)) INTCONbits.TMR0IF = 1;
+    lastTmr0Count = count;
+    TMR0 = (uint8_t)count;
+}
+
+void SIM_AdvanceTo(uint32_t us) {
+    while (simTimeUs < us) {
+        uint32_t frame = simTimeUs / SIM_FRAME_US;
+        uint32_t next = (frame + 1) * SIM_FRAME_US;
+        uint32_t poll = frame * SIM_FRAME_US + pollPhaseUs;
+
+        // Stop at the next event: host poll, frame start, bus state change or the target
+        if (poll > simTimeUs && poll < next) next = poll;
+        if (busState == BUS_SUSPENDED && busIdleUs + SIM_IDLE_US > simTimeUs
+            && busIdleUs + SIM_IDLE_US < next) next = busIdleUs + SIM_IDLE_US;
+        if (busState == BUS_RESUMING && busUpUs < next) next = busUpUs;
+        if (next > us) next = us;
+
+        // USBCBSendResume() drives the K-state: the host answers with the resume
+        if (UCONbits.RESUME && busState == BUS_SUSPENDED) {
+            if (simOut != NULL) fprintf(simOut, "%9lu RWK\n", (unsigned long)simTimeUs);
+            SimBusResume();
+        }
+        uint32_t from = simTimeUs;
+        simTimeUs = next;
+        SimTimers(from);
+        SimClock();
+
+        if (busState == BUS_RESUMING && simTimeUs >= busUpUs) {
+            // End of the resume signalling: SOFs again, polls after the recovery time
+            busState = BUS_RUNNING;
+            pollUpUs = simTimeUs + SIM_RECOVERY_US;
+            lastFrame = simTimeUs / SIM_FRAME_US;
+            if (simOut != NULL) fprintf(simOut, "%9lu RES\n", (unsigned long)simTimeUs);
+        }
+        if (busState == BUS_SUSPENDED && simTimeUs >= busIdleUs + SIM_IDLE_US
+            && !idleSeen && USBDeviceState == CONFIGURED_STATE) {
+            idleSeen = true;
+            idlePending = true;
+        }
+        if (busState != BUS_RUNNING) {
+            lastFrame = simTimeUs / SIM_FRAME_US;
+        } else {
+            if (simTimeUs / SIM_FRAME_US != lastFrame) {
+                lastFrame = simTimeUs / SIM_FRAME_US;
+                sofPending = true;
+            }
+            if (simTimeUs % SIM_FRAME_US == pollPhaseUs && USBDeviceState == CONFIGURED_STATE
+                && simTimeUs >= pollUpUs) {
+                SimHostPoll();
+            }
+        }
+        SimUSBInterrupt();
+    }
+}
+
+void SIM_USBSetPollPhase(uint32_t us) {
+    pollPhaseUs = us % SIM_FRAME_US;
+}
+
+uint32_t SIM_USBCadence(uint32_t *maxGapUs) {
+    uint32_t count = pollCount;
+
+    *maxGapUs = pollMaxGapUs;
+    pollCount = 0;
+    pollMaxGapUs = 0;
+    return count;
+}
+
+void SIM_USBConfigure(void) {
+    USBDeviceState = CONFIGURED_STATE;
+    USBActiveConfiguration = 1;
+    USER_USB_CALLBACK_EVENT_HANDLER((USB_EVENT)EVENT_CONFIGURED, (void*)&USBActiveConfiguration, 1);
+#if defined(USB_INTERRUPT)
+    // USBDeviceAttach() enables the USB interrupt, main() sets GIE
+    PIE2bits.USBIE = 1;
+    INTCONbits.PEIE = 1;
+    INTCONbits.GIE = 1;
+#endif
+}
+
+void SIM_USBSuspend(void) {
+    if (busState != BUS_RUNNING) return;
+
+    busState = BUS_SUSPENDED;
+    busIdleUs = simTimeUs;
+    idleSeen = false;
+}
+
+void SIM_USBResume(void) {
+    SimBusResume();
+}
+
+/**
+ * Sleep wake-up sources of the firmware: interrupt-on-change and the
+ * USB bus activity interrupt (peripheral interrupt)
+ * @return true if one has fired
+ */
+static bool SimWakeSource(void) {
+    if (INTCONbits.IOCIE && (IOCAF | IOCBF) != 0) return true;
+    if (INTCONbits.PEIE && PIE2bits.USBIE && UIEbits.ACTVIE && UIRbits.ACTVIF) return true;
+    return false;
+}
+
+void SIM_Sleep(void) {
+    // WDTPS 1:32 = 1ms, doubling per step
+    uint32_t wdtUs = simTimeUs + (1000u << ((WDTCON >> 1) & 0x1F));
+
+    for (;;) {
+        uint32_t next = simTimeUs + SIM_SLEEP_STEP_US;
+
+        if (simSleepTask != NULL) simSleepTask();
+        if (SimWakeSource()) return;
+        if ((WDTCON & 0x01) && simTimeUs >= wdtUs) return;   // watchdog time-out
+
+        if ((WDTCON & 0x01) && next > wdtUs) next = wdtUs;
+        SIM_AdvanceTo(next);
+    }
+}
+
+void SIM_USBTasks(void) {
+    // Bus activity during suspend (USBDeviceTasks() task A)
+    if (UIRbits.ACTVIF && UIEbits.ACTVIE) {
+        UIRbits.ACTVIF = 0;
+        USBWakeFromSuspend();
+    }
+    if (UCONbits.SUSPND) return;
+
+    // 3ms of idle
+    if (idlePending) {
+        idlePending = false;
+        if (simOut != NULL) fprintf(simOut, "%9lu SUS\n", (unsigned long)simTimeUs);
+        USBSuspend();
+        return;
+    }
+
+    if (transferPending) {
+        USTAT_FIELDS stat;
+
+        transferPending = false;
+        stat.Val = 0;
+        stat.endpoint_number = JOYSTICK_EP;
+        stat.direction = IN_TO_HOST;
+        stat.ping_pong = transferBdt;
+        USER_USB_CALLBACK_EVENT_HANDLER(EVENT_TRANSFER, (uint8_t*)&stat.Val, 0);
+    }
+    if (!sofPending) return;
+
+    sofPending = false;
+    tick1ms++;
+    if (USBDeviceState == CONFIGURED_STATE) {
+        USER_USB_CALLBACK_EVENT_HANDLER(EVENT_SOF, 0, 1);
+    }
+}
+
+USB_USER_DEVICE_DESCRIPTOR_INCLUDE;
+extern const uint8_t *const USB_SD_Ptr[];
+
+/**
+ * Standard device requests handled by usb_device.c that the traces and
+ * the EP0 benchmark use
+ * @param setup 8 byte SETUP packet
+ * @param data Buffer for the IN data stage
+ * @return Bytes of the IN data stage, -1 to stall, -2 if not handled here
+ */
+static int SimStdRequest(const uint8_t *setup, uint8_t *data) {
+    if (setup[0] == 0x80 && setup[1] == USB_REQUEST_GET_DESCRIPTOR) {
+        // USBStdGetDscHandler(): the data stage stops at wLength
+        uint16_t len = (uint16_t)(setup[6] | (setup[7] << 8));
+        const uint8_t *dsc;
+        uint16_t size;
+
+        switch (setup[3]) {
+            case USB_DESCRIPTOR_DEVICE:
+                dsc = (const uint8_t*)USB_USER_DEVICE_DESCRIPTOR;
+                size = sizeof(device_dsc);
+                break;
+            case USB_DESCRIPTOR_CONFIGURATION:
+                if (setup[2] != 0) return -1;               // USB_MAX_NUM_CONFIG_DSC 1
+                dsc = USB_USER_CONFIG_DESCRIPTOR[setup[2]];
+                size = (uint16_t)(dsc[2] | (dsc[3] << 8));
+                break;
+            case USB_DESCRIPTOR_STRING:
+                if (setup[2] >= USB_NUM_STRING_DESCRIPTORS) return -1;
+                dsc = USB_SD_Ptr[setup[2]];
+                size = dsc[0];
+                break;
+            default:
+                return -1;
+        }
+        if (len > size) len = size;
+        memcpy(data, dsc, len);
+        return len;
+    }
+    if (setup[0] == 0x00 && (setup[1] == USB_REQUEST_SET_ADDRESS || setup[1] == USB_REQUEST_SET_CONFIGURATION)) {
+        // No data stage; the device state is set by SIM_USBConfigure()
+        return 0;
+    }
+    if (setup[0] == 0x80 && setup[1] == USB_REQUEST_GET_STATUS) {
+        // USBStdGetStatusHandler(): bus powered, remote wakeup status
+        data[0] = RemoteWakeup ? 0x02 : 0x00;
+        data[1] = 0;
+        return 2;
+    }
+    if (setup[0] == 0x00 && setup[2] == USB_FEATURE_DEVICE_REMOTE_WAKEUP
+        && (setup[1] == USB_REQUEST_SET_FEATURE || setup[1] == USB_REQUEST_CLEAR_FEATURE)) {
+        // USBStdFeatureReqHandler(): only with _RWU in the configuration descriptor
+        if (((*USB_USER_CONFIG_DESCRIPTOR)[7] & _RWU) == 0) return -1;
+        RemoteWakeup = (setup[1] == USB_REQUEST_SET_FEATURE);
+        return 0;
+    }
+    return -2;
+}
+
+int SIM_USBControl(const uint8_t *setup, uint8_t *data) {
+    uint16_t len = (uint16_t)(setup[6] | (setup[7] << 8));
+    int std;
+
+    if ((std = SimStdRequest(setup, data)) != -2) return std;
+
+    memcpy((void*)&SetupPkt, setup, 8);
+    inPipes[0].info.Val = 0;
+    outPipes[0].info.Val = 0;
+
+    USER_USB_CALLBACK_EVENT_HANDLER((USB_EVENT)EVENT_EP0_REQUEST, 0, 0);
+
+    if (outPipes[0].info.bits.busy) {
+        // OUT data stage, then the completion callback
+        if (len > outPipes[0].wCount.Val) len = outPipes[0].wCount.Val;
+        memcpy(outPipes[0].pDst.bRam, data, len);
+        outPipes[0].info.Val = 0;
+        if (outPipes[0].pFunc != NULL) outPipes[0].pFunc();
+        return 0;
+    }
+    if (inPipes[0].info.bits.busy) {
+        // IN data stage (status only when nothing is to be sent)
+        if (len > inPipes[0].wCount.Val) len = inPipes[0].wCount.Val;
+        if (len != 0) {
+            memcpy(data, inPipes[0].info.bits.ctrl_trf_mem ? (const void*)inPipes[0].pSrc.bRam
+                                                           : (const void*)inPipes[0].pSrc.bRom, len);
+        }
+        inPipes[0].info.Val = 0;
+        return len;
+    }
+    return -1;
+}
+
+/* ── usb_device.c API used by the application ─────────────────────────────── */
+
+void USBEnableEndpoint(uint8_t ep, uint8_t options) {
+    if (ep > USB_MAX_EP_NUMBER) return;
+
+    epEnabled[ep] = options;
+    if (ep == JOYSTICK_EP) {
+        // USBConfigureEndpoint(): both BDTs released, restart from the even one
+        ep1In[0].STAT.Val = 0;
+        ep1In[1].STAT.Val = 0;
+        ep1Next = 0;
+        ep1HostNext = 0;
+    }
+}
+
+USB_HANDLE USBTransferOnePacket(uint8_t ep, uint8_t dir, uint8_t *data, uint8_t len) {
+    if (ep != JOYSTICK_EP || dir != IN_TO_HOST || !(epEnabled[ep] & USB_IN_ENABLED)) return 0;
+
+    volatile BDT_ENTRY *bd = &ep1In[ep1Next];
+
+    ep1Buf[ep1Next] = data;
+    ep1ArmedUs[ep1Next] = simTimeUs;
+    ep1Next ^= 1;
+    bd->CNT = len;
+    bd->STAT.UOWN = 1;
+    SimPrintPacket("TX", data, len);
+    return (USB_HANDLE)bd;
+}
+
+void USBDeviceTasks(void) {
+    SIM_USBTasks();
+}
+
+uint32_t USBGet1msTickCount(void) {
+    return tick1ms;
+}
+
+void SIM_Delay(uint32_t cycles) {
+    SIM_AdvanceTo(simTimeUs + cycles / (SIM_FOSC_HZ / 4 / 1000000u));
+}
+
+volatile uint8_t *SIM_OscStat(void) {
+    // A pass of the PLLRDY wait loop
+    if (pllOn && !pllLocked) SIM_AdvanceTo(simTimeUs + SIM_PLL_POLL_US);
+    SimClock();
+    return &OSCSTAT;
+}
@@ -0,0 +1,227 @@
+/*******************************************************************************
+Copyright 2025 Custom USB Gamepad Project
+
+Macro recorder / player test
+
+Records random button timelines through Macro_Sample() with skipped
+frames (main loop stalls), several samples per frame and a stop combo tail,
+decodes the macro steps with the host codec and plays them back, also
+across the 16 bit frame counter wrap.  Steps made by the host encoder
+must play back frame by frame as well.
+*******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include "macro.h"
+#include "macro_codec.h"
+#include "io_mapping.h"
+
+#define FRAMES_MAX  (1u << 19)
+#define RUNS_MAX    MACRO_STEPS
+#define LIVE        (BUTTON_SNAP_Y | BUTTON_SNAP_SELECT)    // never recorded
+
+static unsigned failures;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { printf("FAIL %s:%d %s\n", __func__, __LINE__, #cond); failures++; } \
+    } while (0)
+
+/* Body states: no Select or L, so that only the tail is cut */
+static const uint16_t pool[] = {
+    0,
+    BUTTON_SNAP_A,
+    BUTTON_SNAP_A | BUTTON_SNAP_RIGHT,
+    BUTTON_SNAP_B | BUTTON_SNAP_DOWN | BUTTON_SNAP_LEFT,
+    BUTTON_SNAP_X | BUTTON_SNAP_Y | BUTTON_SNAP_UP,
+    BUTTON_SNAP_TR,
+    BUTTON_SNAP_START
+};
+#define POOL_SIZE   (sizeof(pool) / sizeof(pool[0]))
+
+static uint32_t seed = 12345;
+static uint16_t expected[FRAMES_MAX];   // recorded state of each frame
+static uint16_t played[FRAMES_MAX];
+static MACRO_RUN runs[RUNS_MAX];
+
+static uint32_t Rand(uint32_t n) {
+    seed = seed * 1103515245u + 12345u;
+    return (seed >> 8) % n;
+}
+
+/**
+ * Decode the stored macro into frames
+ * @param frames Buffer of FRAMES_MAX states
+ * @return Number of frames, or -1 without a macro
+ */
+static long Decode(uint16_t *frames) {
+    long len = 0;
+    int n;
+
+    if ((n = MacroCodec_Decode(macroSteps, macroLength, runs, RUNS_MAX)) < 0) return -1;
+    for (int i = 0; i < n; i++) {
+        for (uint32_t f = 0; f < runs[i].frames && len < (long)FRAMES_MAX; f++) frames[len++] = runs[i].snap;
+    }
+    return len;
+}
+
+/**
+ * Play the stored macro with skipped frames and repeated samples
+ * @param len Expected number of frames
+ * @param frame0 USB frame count of the first frame
+ */
+static void Play(long len, uint16_t frame0) {
+    CHECK(Macro_Play(frame0));
+
+    for (long k = 0; k < len + 3; k++) {
+        uint16_t frame = (uint16_t)(frame0 + k);
+        uint16_t got;
+        uint16_t want = (k < len) ? expected[k] : LIVE;
+
+        if (k != 0 && k != len + 2 && Rand(8) == 0) continue;  // no sample in this frame
+        if (Rand(4) == 0) Macro_Sample(LIVE, frame);    // extra sample, same frame
+        got = Macro_Sample(LIVE, frame);
+        if (got != want) {
+            printf("frame %ld: played %04X, want %04X\n", k, got, want);
+            failures++;
+            Macro_Stop();
+            return;
+        }
+    }
+    CHECK(Macro_GetState() == MACRO_IDLE);
+}
+
+/**
+ * Record a random timeline, check what was stored and play it back
+ * @param changes Number of state changes of the body
+ * @param longRuns Use runs longer than MACRO_FRAMES_MAX frames
+ * @param tail Number of stop combo states at the end
+ * @param frame0 USB frame count of the first recorded frame
+ */
+static void RecordAndPlay(unsigned changes, bool longRuns, unsigned tail, uint16_t frame0) {
+    uint16_t frame = frame0;
+    uint16_t state = BUTTON_SNAP_A;
+    long len = 0;
+    long stored;
+    bool full = false;
+
+    Macro_Record();
+    CHECK(Macro_GetState() == MACRO_ARMED);
+
+    // The start combo is released, then the first press starts the recording
+    Macro_Sample(BUTTON_SNAP_SELECT | BUTTON_SNAP_TL, (uint16_t)(frame - 2));
+    Macro_Sample(0, (uint16_t)(frame - 1));
+
+    for (unsigned c = 0; c < changes && !full; c++) {
+        uint32_t frames = longRuns ? 1 + Rand(3 * MACRO_FRAMES_MAX) : 1 + Rand(12);
+
+        if (c != 0) {
+            uint16_t next;
+            do next = pool[Rand(POOL_SIZE)]; while (next == state);
+            state = next;
+        }
+        for (uint32_t f = 0; f < frames && len < (long)FRAMES_MAX - 64; f++, frame++) {
+            if (len != 0 && Rand(10) == 0) {
+                expected[len] = expected[len - 1];      // stalled: the state holds
+            } else {
+                if (Rand(3) == 0) Macro_Sample(BUTTON_SNAP_B, frame);  // overwritten in the frame
+                Macro_Sample(state, frame);
+                expected[len] = state;
+            }
+            len++;
+            if (Macro_GetState() != MACRO_RECORDING) {
+                full = true;
+                break;
+            }
+        }
+    }
+    CHECK(!(state & (BUTTON_SNAP_SELECT | BUTTON_SNAP_TL)));
+
+    // Stop combo tail: cut when the recording stops
+    for (unsigned t = 0; t < tail && !full; t++) {
+        static const uint16_t combo[] = {
+            BUTTON_SNAP_SELECT,
+            BUTTON_SNAP_SELECT | BUTTON_SNAP_TL,
+            BUTTON_SNAP_SELECT | BUTTON_SNAP_TL | BUTTON_SNAP_A,
+            BUTTON_SNAP_TL | BUTTON_SNAP_DOWN
+        };
+        Macro_Sample(combo[t % 4], frame++);
+        if (Macro_GetState() != MACRO_RECORDING) full = true;
+    }
+    Macro_Sample(BUTTON_SNAP_SELECT | BUTTON_SNAP_TL, frame++);
+    if (Macro_GetState() != MACRO_RECORDING) full = true;
+    Macro_Stop();
+    CHECK(Macro_GetState() == MACRO_IDLE);
+
+    stored = Decode(played);
+    if (full) {
+        // The area filled up: a prefix is kept, the last run may be shorter
+        CHECK(stored > 0 && stored <= len);
+        len = stored;
+    } else {
+        // Every body frame, without the tail
+        CHECK(stored == len);
+    }
+    if (stored > 0 && memcmp(played, expected, (size_t)len * sizeof(expected[0])) != 0) {
+        printf("recorded frames differ (changes %u, tail %u)\n", changes, tail);
+        failures++;
+        return;
+    }
+
+    Play(len, (uint16_t)(frame0 + 0x1234));
+    Play(len, 0xFFF0);          // across the frame counter wrap
+}
+
+static void TestCodec(void) {
+    static MACRO_RUN in[64];
+    MACRO_STEP steps[MACRO_STEPS];
+
+    for (unsigned round = 0; round < 50; round++) {
+        size_t n = 1 + Rand(4);     // up to 4 steps per run
+        long len = 0;
+        int used;
+
+        for (size_t i = 0; i < n; i++) {
+            in[i].snap = pool[Rand(POOL_SIZE)] | ((Rand(5) == 0) ? BUTTON_SNAP_SELECT : 0);
+            in[i].frames = (Rand(6) == 0 && len < (long)FRAMES_MAX / 2) ? 1 + Rand(3 * MACRO_FRAMES_MAX) : 1 + Rand(30);
+            for (uint32_t f = 0; f < in[i].frames; f++) expected[len++] = in[i].snap;
+        }
+        used = MacroCodec_Encode(in, n, steps);
+        CHECK(used > 0 && used <= MACRO_STEPS);
+
+        // Decoding gives the same frames
+        memcpy(macroSteps, steps, sizeof(macroSteps));
+        macroLength = (uint8_t)used;
+        CHECK(Decode(played) == len);
+        CHECK(memcmp(played, expected, (size_t)len * sizeof(expected[0])) == 0);
+
+        // and so does the player
+        Play(len, (uint16_t)Rand(0x10000));
+    }
+
+    // Too long, and no macro
+    for (size_t i = 0; i < 64; i++) {
+        in[i].snap = pool[1 + i % 2];
+        in[i].frames = 2;
+    }
+    CHECK(MacroCodec_Encode(in, 64, steps) == -1);
+    macroLength = 0;
+    CHECK(!Macro_Play(0));
+}
+
+int main(void) {
+    for (unsigned round = 0; round < 40; round++) {
+        RecordAndPlay(1 + Rand(25), false, Rand(3) ? 0 : 1 + Rand(60), (uint16_t)Rand(0x10000));
+    }
+    RecordAndPlay(3, true, 2, 100);     // runs over MACRO_FRAMES_MAX frames
+    RecordAndPlay(500, false, 0, 200);  // fills the macro area
+    TestCodec();
+
+    // An aborted recording leaves no macro
+    RecordAndPlay(5, false, 0, 300);
+    Macro_Record();
+    Macro_Stop();
+    CHECK(Macro_GetState() == MACRO_IDLE && !Macro_Play(0));
+
+    printf("%u failures\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,585 @@
+/*******************************************************************************
+Copyright 2025 Custom USB Gamepad Project
+
+Mapping store test
+
+mapping.c is included to reach its log helpers.  Checks the CRC8
+against its check value, the defaults on blank flash and over a record
+of the baseline firmware, that the parser skips unknown tags and copes
+with longer, too short and cut entries and stale rows, that a save appends
+only the changed tags and erases a row only when the log moves on, that
+random saves read back across many wraps and stay readable when cut after
+any step, the tag and command feature reports (commands write no flash
+until committed), that settings written through the feature report
+survive a reload, and that profile switches never touch the flash.
+*******************************************************************************/
+
+#include "mapping.c"
+#include <stdio.h>
+#include "sim.h"
+
+static unsigned failures;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { printf("FAIL %s:%d %s\n", __func__, __LINE__, #cond); failures++; } \
+    } while (0)
+
+/**
+ * Erase every HEF row
+ */
+static void EraseHEF(void) {
+    NVM_UnlockKeySet(UNLOCK_KEY);
+    for (uint8_t row = 0; row < HEF_ROWS; row++) FLASH_PageErase(HEF_ADDR + row * ROW_WORDS);
+    NVM_UnlockKeyClear();
+}
+
+/**
+ * Program words of a HEF row, leaving the others as they are
+ * @param row HEF row
+ * @param bytes Low bytes of the words
+ * @param first First word
+ * @param n Number of words
+ */
+static void Program(uint8_t row, const uint8_t *bytes, uint8_t first, uint8_t n) {
+    flash_data_t words[ROW_WORDS];
+
+    for (uint8_t i = 0; i < ROW_WORDS; i++) words[i] = 0x3FFF;
+    for (uint8_t i = 0; i < n; i++) words[first + i] = 0x3F00 | bytes[i];
+    NVM_UnlockKeySet(UNLOCK_KEY);
+    FLASH_RowWrite(Mapping_RowAddr(row), words);
+    NVM_UnlockKeyClear();
+}
+
+/**
+ * Write a log row by hand: the header, then each tag of a tag list
+ * followed by its CRC
+ * @param row HEF row
+ * @param seq Sequence number of the row
+ * @param tags Tags with their values, as many value bytes as the tag says
+ * @param len Length of tags
+ */
+static void WriteRow(uint8_t row, uint8_t seq, const uint8_t *tags, uint8_t len) {
+    uint8_t bytes[ROW_WORDS];
+    uint8_t entry[ROW_HEADER + 1 + 15];
+    uint8_t pos = ROW_HEADER;
+
+    memset(bytes, 0xFF, sizeof(bytes));
+    bytes[0] = entry[0] = seq;
+    bytes[1] = entry[1] = REC_VER;
+    for (uint8_t i = 0; i < len && pos < ROW_WORDS; ) {
+        uint8_t n = MAP_TAG_LEN(tags[i]);
+
+        memcpy(&entry[ROW_HEADER], &tags[i], (size_t)(1 + n));
+        for (uint8_t b = 0; b <= n && pos < ROW_WORDS; b++) bytes[pos++] = tags[i + b];
+        if (pos < ROW_WORDS) bytes[pos++] = crc8(entry, (uint8_t)(ROW_HEADER + 1 + n));
+        i += 1 + n;
+    }
+    Program(row, bytes, 0, ROW_WORDS);
+}
+
+/**
+ * Run Mapping_Tasks() until the pending commit is done
+ */
+static void Commit(void) {
+    for (uint8_t i = 0; i < 16 && pendingTags != 0; i++) Mapping_Tasks();
+}
+
+/**
+ * Forget the RAM map and load it from the HEF again
+ */
+static void Reload(void) {
+    memset(&map, 0, sizeof(map));
+    Mapping_Load();
+}
+
+/**
+ * Read-modify-write the feature report
+ * @param off Byte offset
+ * @param val New value
+ */
+static void SetByte(uint8_t off, uint8_t val) {
+    uint8_t report[64];
+
+    Mapping_GetAsFeatureReport(report);
+    report[off] = val;
+    Mapping_SetFromFeatureReport(report, sizeof(report));
+}
+
+static void TestCrc8(void) {
+    uint8_t buf[65];
+    uint32_t seed = 1;
+
+    // CRC-8 check value, and one bit through the polynomial
+    CHECK(crc8((const uint8_t*)"123456789", 9) == 0xF4);
+    buf[0] = 0x01;
+    CHECK(crc8(buf, 1) == 0x07);
+
+    // A message followed by its CRC has CRC 0
+    for (uint8_t len = 0; len < sizeof(buf); len++) {
+        for (uint8_t i = 0; i < len; i++) {
+            seed = seed * 1103515245u + 12345u;
+            buf[i] = (uint8_t)(seed >> 16);
+        }
+        buf[len] = crc8(buf, len);
+        CHECK(crc8(buf, (uint8_t)(len + 1)) == 0);
+    }
+}
+
+static void TestDefaults(void) {
+    uint8_t report[64];
+    uint8_t crc;
+
+    EraseHEF();
+    Mapping_Load();
+
+    CHECK(commitStatus == MAP_STATUS_COMMITTED && pendingTags == 0);
+    CHECK(Mapping_GetProfile() == 0);
+    CHECK(Mapping_GetUsage(PHYS_BTN_B, 0) == 2);
+    CHECK(Mapping_GetUsage(PHYS_BTN_B, 1) == 11);
+    CHECK(Mapping_GetUsage(PHYS_BTN_B, 3) == 2);
+    CHECK(Mapping_GetTurboMask() == 0);
+    CHECK(map.profile[0].socd == 0 && Mapping_GetCrosskey() == 0);
+
+    Mapping_GetAsFeatureReport(report);
+    CHECK(report[1] == MAP_VER && report[MAP_RPT_COUNT_OFFSET] == MAP_PROFILES);
+    CHECK(memcmp(&report[25], "NORM", PROFILE_NAME_LEN) == 0);
+    crc = report[2];
+    report[2] = 0;
+    CHECK(crc == crc8(report, MAP_RPT_STATUS_OFFSET));
+}
+
+static void TestBaselineRecord(void) {
+    uint8_t old[2 * ROW_WORDS];
+    uint16_t erases;
+
+    // The 64 byte record of the baseline firmware (version 1) in rows 0-1:
+    // not a log row, so the defaults are used
+    EraseHEF();
+    memset(old, 0, sizeof(old));
+    old[1] = 0x01;
+    old[2] = crc8(old, sizeof(old) - 1);
+    for (uint8_t i = 0; i < NUM_BUTTONS; i++) old[8 + i] = (uint8_t)(NUM_BUTTONS - i);
+    Program(0, old, 0, ROW_WORDS);
+    Program(1, &old[ROW_WORDS], 0, ROW_WORDS);
+
+    Mapping_Load();
+    CHECK(commitStatus == MAP_STATUS_COMMITTED && pendingTags == 0);
+    CHECK(!Mapping_RowIsValid(0) && !Mapping_RowIsValid(1));
+    CHECK(Mapping_GetUsage(PHYS_BTN_A, 0) == 1 && Mapping_GetUsage(PHYS_BTN_START, 0) == 8);
+    CHECK(memcmp(map.profile[1].name, "SPCL", PROFILE_NAME_LEN) == 0);
+
+    // The first save erases row 0 and starts the log there
+    erases = simFlashErases;
+    SetByte(3, 6);
+    Commit();
+    CHECK(simFlashErases == erases + 1 && logRow == 0 && logSeq == 0);
+    Reload();
+    CHECK(map.debounce_ms == 6 && Mapping_GetUsage(PHYS_BTN_A, 0) == 1);
+}
+
+/* Tag lists with unknown, longer, too short and invalid tags */
+static const uint8_t oddTags[] = {
+    MAP_TAG(0x3, 2), 0xAA, 0xBB,                    // unknown type: skipped
+    MAP_TAG(MAP_TAG_PAD, 0),
+    MAP_TAG(MAP_TAG_GLOBAL, 5), 9, 1, 60, 0, 0xEE,  // longer: prefix used, sof_phase clamped
+    MAP_TAG(MAP_TAG_PROFILE, 3), 'S', 'H', 'O',     // too short: ignored
+};
+
+static const uint8_t longTag[] = {
+    MAP_TAG(MAP_TAG_PROFILE + 1, 14),               // profile 1 with one more byte
+        'T', 'L', 'V', 0, 0x21, 0x43, 0x65, 0x87, 0x03, 0, 0, 0, 0x26, 0x77,
+};
+
+static const uint8_t badTag[] = {
+    MAP_TAG(MAP_TAG_PROFILE + 2, 13),               // usage out of range: ignored
+        'B', 'A', 'D', 0, 0x0F, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+/**
+ * Check the RAM map holds oddTags, longTag and badTag over the defaults
+ */
+static void CheckOddTags(void) {
+    CHECK(map.debounce_ms == 9 && map.keepalive == 1 && map.sof_phase == SOF_PHASE_MAX);
+    CHECK(memcmp(map.profile[0].name, "NORM", PROFILE_NAME_LEN) == 0);
+    CHECK(memcmp(map.profile[1].name, "TLV", PROFILE_NAME_LEN) == 0);
+    CHECK(Mapping_GetUsage(PHYS_BTN_A, 1) == 1 && map.profile[1].turbo[PHYS_BTN_A] == 3);
+    CHECK(map.profile[1].socd == SOCD_POLICY(2, 1) && map.profile[1].crosskey == 2);
+    CHECK(Mapping_GetUsage(PHYS_BTN_A, 2) == 1);
+}
+
+static void TestEntryLog(void) {
+    static const uint8_t global[] = { MAP_TAG(MAP_TAG_GLOBAL, 4), 2, 0, 0, 0 };
+    uint16_t erases, writes;
+    uint8_t tags[sizeof(global) + sizeof(badTag)];
+    uint8_t bytes[3];
+
+    // Nothing changed: nothing written
+    EraseHEF();
+    Mapping_Load();
+    erases = simFlashErases;
+    writes = simFlashWrites;
+    Mapping_Save();
+    Commit();
+    CHECK(commitStatus == MAP_STATUS_COMMITTED && simFlashErases == erases && simFlashWrites == writes);
+
+    // Hand made rows: odd tags, a longer profile
+    WriteRow(0, 0x40, oddTags, sizeof(oddTags));
+    WriteRow(1, 0x41, longTag, sizeof(longTag));
+    Reload();
+    CheckOddTags();
+    CHECK(logRow == 1 && logSeq == 0x41 && logPos == ROW_HEADER + sizeof(longTag) + 1);
+    CHECK(tagRow[0] == 0 && tagRow[2] == 1 && tagRow[1] == NO_ROW);
+
+    // The next row wins, an invalid tag is skipped; a row with a stale
+    // sequence number is not read
+    memcpy(tags, global, sizeof(global));
+    memcpy(&tags[sizeof(global)], badTag, sizeof(badTag));
+    WriteRow(2, 0x42, tags, sizeof(global) + sizeof(badTag));
+    WriteRow(3, 0x10, global, sizeof(global));
+    Reload();
+    CHECK(logRow == 2 && map.debounce_ms == 2 && map.keepalive == 0 && map.sof_phase == 0);
+    CHECK(memcmp(map.profile[1].name, "TLV", PROFILE_NAME_LEN) == 0 && map.profile[2].name[0] == 'P');
+
+    // An entry cut short ends the row: the next save moves on to row 3
+    bytes[0] = MAP_TAG(MAP_TAG_GLOBAL, 4);
+    bytes[1] = 5;
+    bytes[2] = 0;
+    Program(2, bytes, logPos, sizeof(bytes));
+    Reload();
+    CHECK(map.debounce_ms == 2 && logPos == ROW_WORDS);
+    SetByte(3, 6);
+    Commit();
+    Reload();
+    CHECK(logRow == 3 && logSeq == 0x43 && map.debounce_ms == 6);
+    CHECK(memcmp(map.profile[1].name, "TLV", PROFILE_NAME_LEN) == 0);
+
+    // Garbage after the last entry also ends the row
+    bytes[0] = 0x5A;
+    Program(3, bytes, ROW_WORDS - 1, 1);
+    Reload();
+    CHECK(logRow == 3 && logPos == ROW_WORDS && map.debounce_ms == 6);
+}
+
+static void TestAppend(void) {
+    uint16_t erases, writes;
+
+    EraseHEF();
+    Mapping_Load();
+    erases = simFlashErases;
+    writes = simFlashWrites;
+
+    // One profile saved 39 times: 2 saves per row, a row erase every second save
+    for (uint8_t i = 0; i < 39; i++) {
+        SetByte(16 + PHYS_BTN_A, (uint8_t)(1 + i % MAP_TURBO_MAX));
+        Commit();
+        CHECK(commitStatus == MAP_STATUS_COMMITTED);
+    }
+    CHECK(simFlashErases - erases == 20 && simFlashWrites - writes == 39);
+    Reload();
+    CHECK(map.profile[0].turbo[PHYS_BTN_A] == 1 + 38 % MAP_TURBO_MAX);
+
+    // The global settings (6 bytes) fit after the profile entry of a row
+    erases = simFlashErases;
+    SetByte(4, 7);
+    Commit();
+    CHECK(simFlashErases == erases && logPos == ROW_HEADER + 15 + 6);
+}
+
+static void TestCompaction(void) {
+    MAP_PROFILE expected[MAP_PROFILES];
+    uint8_t global[MAP_TAG_GLOBAL_LEN] = { BUTTON_DEBOUNCE_DEFAULT_MS, 0, 0, PERSONALITY_GENERIC };
+    uint32_t seed = 7;
+    uint16_t erases;
+    uint16_t saves = 0;
+
+    EraseHEF();
+    Mapping_Load();
+    memcpy(expected, map.profile, sizeof(expected));
+    erases = simFlashErases;
+
+    // Random edits of every tag, each saved and read back: the row erased
+    // when the log moves on never holds the only copy of a tag
+    for (uint16_t i = 0; i < 500; i++) {
+        uint8_t n;
+
+        seed = seed * 1103515245u + 12345u;
+        n = (uint8_t)((seed >> 16) % (MAP_PROFILES + 1));
+        if (n == MAP_PROFILES) {
+            global[0] = (uint8_t)(seed >> 24);
+            Mapping_StoreGlobal(global);
+        } else {
+            expected[n].tbl[(seed >> 24) % NUM_BUTTONS] = (uint8_t)(1 + (seed >> 8) % (NUM_USAGES - 1));
+            expected[n].name[0] = (uint8_t)('A' + i % 26);
+            Mapping_StoreProfile(n, &expected[n]);
+        }
+        Mapping_Save();
+        Commit();
+        saves++;
+        CHECK(commitStatus == MAP_STATUS_COMMITTED);
+
+        Reload();
+        CHECK(map.debounce_ms == global[0] && memcmp(map.profile, expected, sizeof(expected)) == 0);
+        if (failures) break;
+    }
+    // Every tag live (66 of 120 bytes): still fewer row erases than saves
+    CHECK(simFlashErases - erases < saves);
+}
+
+static void TestPowerCut(void) {
+    MAP_PROFILE before[MAP_PROFILES];
+    MAP_PROFILE after[MAP_PROFILES];
+    uint32_t seed = 3;
+
+    EraseHEF();
+    Mapping_Load();
+
+    // A save cut after any step leaves each tag either old or new
+    for (uint16_t i = 0; i < 300; i++) {
+        uint8_t steps;
+
+        memcpy(before, map.profile, sizeof(before));
+        seed = seed * 1103515245u + 12345u;
+        for (uint8_t n = 0; n < MAP_PROFILES; n++) {
+            if ((seed >> (16 + n)) & 1) map.profile[n].turbo[i % NUM_BUTTONS] = (uint8_t)((seed >> 8) % (MAP_TURBO_MAX + 1));
+            changedTags |= TAG_BIT_PROFILE(n);
+        }
+        memcpy(after, map.profile, sizeof(after));
+        Mapping_Save();
+        steps = (uint8_t)((seed >> 24) % 4);
+        for (uint8_t s = 0; s < steps; s++) Mapping_Tasks();
+
+        Reload();
+        for (uint8_t n = 0; n < MAP_PROFILES; n++) {
+            CHECK(memcmp(&map.profile[n], &before[n], sizeof(MAP_PROFILE)) == 0
+               || memcmp(&map.profile[n], &after[n], sizeof(MAP_PROFILE)) == 0);
+        }
+        if (failures) break;
+    }
+}
+
+static void TestTagReport(void) {
+    uint8_t report[64];
+    uint8_t len;
+
+    EraseHEF();
+    Mapping_Load();
+
+    // Read a profile, then write it back changed
+    report[0] = MAP_TAG_REPORT_ID;
+    report[1] = MAP_TAG(MAP_TAG_PROFILE + 3, 0);
+    Mapping_SetTagReport(report, 2);
+    len = Mapping_GetTagReport(report);
+    CHECK(len == 2 + MAP_TAG_PROFILE_LEN && report[1] == MAP_TAG(MAP_TAG_PROFILE + 3, MAP_TAG_PROFILE_LEN));
+    CHECK(memcmp(&report[2], "P4", 3) == 0 && report[14] == 0x00);
+    Mapping_SetTagReport(report, len);
+    CHECK(pendingTags == 0);           // unchanged: no flash write
+    report[14] = 0x15;                          // SOCD neutral / neutral, HAT
+    Mapping_SetTagReport(report, len);
+    CHECK(commitStatus == MAP_STATUS_PENDING && map.profile[3].socd == 0x11);
+    CHECK(map.profile[3].crosskey == 1 && Mapping_GetCrosskey() == 0);
+    Commit();
+
+    // The active profile changes at once
+    report[1] = MAP_TAG(MAP_TAG_PROFILE, MAP_TAG_PROFILE_LEN);
+    Mapping_GetTagValue(MAP_TAG_PROFILE, &report[2]);
+    report[6] = 0x12;                           // A: B, B: A
+    report[14] = 0x20;                          // Z/Rz
+    Mapping_SetTagReport(report, len);
+    CHECK(Mapping_GetCompiled()[PHYS_BTN_A].mask == (1 << 1) && Mapping_GetCrosskey() == 2);
+    Commit();
+
+    // Rejected: out of range, too short
+    report[6] = 0xF2;
+    Mapping_SetTagReport(report, len);
+    CHECK(commitStatus == MAP_STATUS_FAILED && pendingTags == 0);
+    Mapping_SetTagReport(report, 5);
+    CHECK(commitStatus == MAP_STATUS_FAILED && Mapping_GetUsage(PHYS_BTN_B, 0) == 1);
+
+    // Unknown types read back without a value
+    report[1] = MAP_TAG(0x5, 0);
+    Mapping_SetTagReport(report, 2);
+    CHECK(Mapping_GetTagReport(report) == 2 && report[1] == MAP_TAG(0x5, 0));
+
+    Reload();
+    CHECK(Mapping_GetUsage(PHYS_BTN_A, 0) == 2 && map.profile[0].crosskey == 2);
+    CHECK(map.profile[3].socd == 0x11);
+}
+
+/**
+ * Send a command report and return its result
+ * @param cmd [op, args...]
+ * @param len Length of cmd
+ * @return MAP_CMD_OK or MAP_CMD_REJECTED
+ */
+static uint8_t Command(const uint8_t *cmd, uint8_t len) {
+    uint8_t report[64];
+
+    report[0] = MAP_CMD_REPORT_ID;
+    memcpy(&report[1], cmd, len);
+    Mapping_SetCommandReport(report, (uint8_t)(len + 1));
+    CHECK(Mapping_GetCommandReport(report) == MAP_CMD_RESULT_LEN && report[1] == cmd[0]);
+    return report[2];
+}
+
+/**
+ * Send a command cut short at every length, with the rest of it still in
+ * the buffer past the length
+ * @param cmd [op, args...] of a command that is accepted whole
+ * @param len Length of cmd
+ * @return true if every cut command was rejected
+ */
+static bool CutCommand(const uint8_t *cmd, uint8_t len) {
+    uint8_t report[64];
+    bool rejected = true;
+
+    for (uint8_t n = 1; n < len; n++) {
+        report[0] = MAP_CMD_REPORT_ID;
+        memcpy(&report[1], cmd, len);
+        Mapping_SetCommandReport(report, (uint8_t)(n + 1));
+        Mapping_GetCommandReport(report);
+        if (report[2] != MAP_CMD_REJECTED) rejected = false;
+    }
+    return rejected;
+}
+
+static void TestCommands(void) {
+    static const uint8_t entry[] = { MAP_CMD_SET_ENTRY, 0, PHYS_BTN_A, 11, 2 };     // A: Home, turbo
+    static const uint8_t range[] = { MAP_CMD_SET_RANGE, 1, 17, 5, 2, 'E', 'D', 'I', 'T' };  // crosskey, name
+    static const uint8_t apply[] = { MAP_CMD_APPLY, MAP_TAG(MAP_TAG_GLOBAL, 4), 8, 0, 0, 0 };
+    static const uint8_t badUsage[] = { MAP_CMD_SET_ENTRY, 0, PHYS_BTN_B, NUM_USAGES, 0 };
+    static const uint8_t badRange[] = { MAP_CMD_SET_RANGE, 0, 20, 3, 'a', 'b', 'c' };
+    static const uint8_t shortRange[] = { MAP_CMD_SET_RANGE, 0, 0, 4, 0 };
+    static const uint8_t badProfile[] = { MAP_CMD_SET_ENTRY, MAP_PROFILES, 0, 1, 0 };
+    static const uint8_t commit[] = { MAP_CMD_COMMIT };
+    uint8_t report[64];
+    uint16_t erases, writes;
+
+    EraseHEF();
+    Mapping_Load();
+    erases = simFlashErases;
+    writes = simFlashWrites;
+
+    // Each command is live at once, nothing goes to the flash
+    CHECK(Command(entry, sizeof(entry)) == MAP_CMD_OK);
+    CHECK(Mapping_GetCompiled()[PHYS_BTN_A].mask == (1 << 2) && Mapping_GetTurboMask() == BUTTON_SNAP_A);
+    CHECK(Command(range, sizeof(range)) == MAP_CMD_OK);
+    CHECK(map.profile[1].crosskey == 2 && memcmp(map.profile[1].name, "EDIT", PROFILE_NAME_LEN) == 0);
+    CHECK(Mapping_GetCrosskey() == 0);
+    CHECK(Command(apply, sizeof(apply)) == MAP_CMD_OK);
+    CHECK(map.debounce_ms == 8);
+    Mapping_GetAsFeatureReport(report);
+    CHECK(report[MAP_RPT_STATUS_OFFSET] == MAP_STATUS_UNSAVED);
+    CHECK(pendingTags == 0 && simFlashErases == erases && simFlashWrites == writes);
+
+    // Rejected commands change nothing
+    CHECK(Command(badUsage, sizeof(badUsage)) == MAP_CMD_REJECTED);
+    CHECK(Command(badRange, sizeof(badRange)) == MAP_CMD_REJECTED);
+    CHECK(Command(shortRange, sizeof(shortRange)) == MAP_CMD_REJECTED);
+    CHECK(Command(badProfile, sizeof(badProfile)) == MAP_CMD_REJECTED);
+    CHECK(CutCommand(entry, sizeof(entry)) && CutCommand(range, sizeof(range)));
+    CHECK(Mapping_GetUsage(PHYS_BTN_B, 0) == 2 && map.profile[0].socd == 0);
+    CHECK(commitStatus == MAP_STATUS_FAILED);
+
+    // The commit appends the three changed tags, which take two rows
+    CHECK(Command(commit, sizeof(commit)) == MAP_CMD_OK);
+    CHECK(commitStatus == MAP_STATUS_PENDING);
+    Commit();
+    CHECK(commitStatus == MAP_STATUS_COMMITTED && changedTags == 0);
+    CHECK(simFlashErases == erases + 2 && simFlashWrites == writes + 2);
+    CHECK(Command(commit, sizeof(commit)) == MAP_CMD_OK && pendingTags == 0);
+
+    Reload();
+    CHECK(Mapping_GetUsage(PHYS_BTN_A, 0) == 11 && map.profile[0].turbo[PHYS_BTN_A] == 2);
+    CHECK(map.debounce_ms == 8 && memcmp(map.profile[1].name, "EDIT", PROFILE_NAME_LEN) == 0);
+}
+
+static void TestTurboRoundTrip(void) {
+    uint8_t report[64];
+
+    EraseHEF();
+    Mapping_Load();
+    SetByte(16 + PHYS_BTN_A, 3);        // profile 0 A: 3 frames on / 3 off
+    Commit();
+    SetByte(MAP_RPT_WINDOW_OFFSET, 1);  // moves the window only
+    CHECK(pendingTags == 0);
+    Mapping_GetAsFeatureReport(report);
+    CHECK(report[8 + PHYS_BTN_B] == 11 && report[16 + PHYS_BTN_A] == 0);
+    SetByte(16 + PHYS_BTN_R, 1);        // profile 1 R: every other frame
+    Commit();
+    CHECK(commitStatus == MAP_STATUS_COMMITTED);
+
+    // Out of range turbo is rejected
+    SetByte(16 + PHYS_BTN_R, MAP_TURBO_MAX + 1);
+    CHECK(commitStatus == MAP_STATUS_FAILED && pendingTags == 0);
+
+    Reload();
+    CHECK(Mapping_GetTurboMask() == BUTTON_SNAP_A);
+    CHECK(Mapping_GetCompiled()[PHYS_BTN_A].turbo == 3);
+    Mapping_SelectProfile(1);
+    CHECK(Mapping_GetTurboMask() == BUTTON_SNAP_TR);
+    CHECK(Mapping_GetCompiled()[PHYS_BTN_R].turbo == 1);
+    Mapping_GetAsFeatureReport(report);
+    CHECK(report[16 + PHYS_BTN_A] == 3);
+}
+
+static void TestSwitchProfiles(void) {
+    const MAP_ENTRY *table;
+    uint8_t report[64];
+    uint16_t erases, writes;
+
+    EraseHEF();
+    Mapping_Load();
+    table = Mapping_GetCompiled();
+
+    // Profile 2: A -> Home, HAT, neutral SOCD, named
+    SetByte(MAP_RPT_WINDOW_OFFSET, 2);
+    Mapping_GetAsFeatureReport(report);
+    report[8 + PHYS_BTN_A] = 11;
+    report[7] = SOCD_POLICY(SOCD_NEUTRAL, SOCD_NEUTRAL);
+    report[24] = 1;
+    memcpy(&report[25], "FGT", 3);
+    Mapping_SetFromFeatureReport(report, sizeof(report));
+    Commit();
+    CHECK(Mapping_GetProfile() == 0 && Mapping_GetCrosskey() == 0);
+
+    // Switching through the report or the API writes no flash
+    erases = simFlashErases;
+    writes = simFlashWrites;
+    SetByte(MAP_RPT_ACTIVE_OFFSET, 2);
+    CHECK(Mapping_GetProfile() == 2 && Mapping_GetCompiled() == table);
+    CHECK(table[PHYS_BTN_A].idx == 1 && table[PHYS_BTN_A].mask == (1 << 2));
+    CHECK(Mapping_GetCrosskey() == 1);
+    Mapping_SetCrosskey(2);
+    Mapping_SelectProfile(1);
+    CHECK(table[PHYS_BTN_B].mask == (1 << 2) && Mapping_GetCrosskey() == 0);
+    Mapping_SelectProfile(2);
+    CHECK(Mapping_GetCrosskey() == 1);
+    Mapping_SelectProfile(MAP_PROFILES);
+    CHECK(Mapping_GetProfile() == 2);
+    SetByte(MAP_RPT_ACTIVE_OFFSET, MAP_PROFILES);
+    CHECK(Mapping_GetProfile() == 2 && commitStatus == MAP_STATUS_FAILED);
+    CHECK(pendingTags == 0 && simFlashErases == erases && simFlashWrites == writes);
+
+    // Everything survives a reload, power-up starts with profile 0
+    Reload();
+    CHECK(Mapping_GetProfile() == 0 && Mapping_GetUsage(PHYS_BTN_A, 2) == 11);
+    CHECK(memcmp(map.profile[2].name, "FGT", 4) == 0);
+    CHECK(map.profile[2].crosskey == 1 && map.profile[2].socd == 0x11);
+}
+
+int main(void) {
+    TestCrc8();
+    TestDefaults();
+    TestBaselineRecord();
+    TestEntryLog();
+    TestAppend();
+    TestCompaction();
+    TestPowerCut();
+    TestTagReport();
+    TestCommands();
+    TestTurboRoundTrip();
+    TestSwitchProfiles();
+
+    printf("%u failures\n", failures);
+    return failures ? 1 : 0;
+}
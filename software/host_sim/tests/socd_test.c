@@ -0,0 +1,113 @@
+/*******************************************************************************
+Copyright 2025 Custom USB Gamepad Project
+
+SOCD cleaning test
+
+Feeds SOCD_Clean() every sequence of SEQ_LEN samples of one axis (each
+sample: none, left/up, right/down or both) under every policy and checks
+the result against a reference model that remembers when each direction
+was pressed.  The other axis and the face buttons must pass through.
+*******************************************************************************/
+
+#include <stdio.h>
+#include "socd.h"
+#include "io_mapping.h"
+
+#define SEQ_LEN     5
+#define STATES      4           // bit0: left/up, bit1: right/down
+
+static const struct {
+    const char *name;
+    uint16_t neg;
+    uint16_t pos;
+    uint16_t other;             // held on the other axis during the test
+} axes[2] = {
+    { "horizontal", BUTTON_SNAP_LEFT, BUTTON_SNAP_RIGHT, BUTTON_SNAP_UP },
+    { "vertical",   BUTTON_SNAP_UP,   BUTTON_SNAP_DOWN,  BUTTON_SNAP_RIGHT }
+};
+
+static const char *const policyNames[SOCD_POLICY_COUNT] = {
+    "priority", "neutral", "last-wins", "first-wins"
+};
+
+/**
+ * Reference resolution of one axis sample
+ * @param policy SOCD_*
+ * @param state Pressed directions (bit0: left/up, bit1: right/down)
+ * @param negAt Sample at which left/up was pressed
+ * @param posAt Sample at which right/down was pressed
+ * @return Surviving directions
+ */
+static unsigned Expected(uint8_t policy, unsigned state, int negAt, int posAt) {
+    if (state != 3) return state;
+
+    switch (policy) {
+        case SOCD_NEUTRAL:
+            return 0;
+        case SOCD_LAST_WINS:
+            return (posAt > negAt) ? 2 : 1;
+        case SOCD_FIRST_WINS:
+            return (posAt < negAt) ? 2 : 1;
+        default:
+            return 1;
+    }
+}
+
+int main(void) {
+    unsigned failures = 0;
+    unsigned checked = 0;
+
+    for (uint8_t axis = 0; axis < 2; axis++) {
+        for (uint8_t policy = 0; policy < SOCD_POLICY_COUNT; policy++) {
+            for (unsigned seq = 0; seq < (1u << (2 * SEQ_LEN)); seq++) {
+                unsigned prev = 0;
+                int negAt = 0;
+                int posAt = 0;
+
+                // the other axis keeps the default policy
+                SOCD_SetPolicy(axis ? SOCD_POLICY(SOCD_PRIORITY, policy)
+                                    : SOCD_POLICY(policy, SOCD_PRIORITY));
+
+                for (int t = 0; t < SEQ_LEN; t++) {
+                    unsigned state = (seq >> (2 * t)) & (STATES - 1);
+                    uint16_t face = (t & 1) ? BUTTON_SNAP_A : BUTTON_SNAP_START;
+                    uint16_t snap = face | axes[axis].other;
+                    uint16_t got;
+                    unsigned want;
+
+                    if ((state & 1) && !(prev & 1)) negAt = t;
+                    if ((state & 2) && !(prev & 2)) posAt = t;
+                    prev = state;
+
+                    if (state & 1) snap |= axes[axis].neg;
+                    if (state & 2) snap |= axes[axis].pos;
+                    got = SOCD_Clean(snap);
+                    want = Expected(policy, state, negAt, posAt);
+                    checked++;
+
+                    if ((got & (face | axes[axis].other)) != (face | axes[axis].other)
+                        || ((got & axes[axis].neg) != 0) != ((want & 1) != 0)
+                        || ((got & axes[axis].pos) != 0) != ((want & 2) != 0)) {
+                        if (failures++ < 10) {
+                            printf("FAIL %s %s sequence", axes[axis].name, policyNames[policy]);
+                            for (int i = 0; i <= t; i++) printf(" %u", (seq >> (2 * i)) & 3);
+                            printf(": got %04X want %u\n", got, want);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Invalid policy nibbles fall back to SOCD_PRIORITY
+    SOCD_SetPolicy(0xFF);
+    checked++;
+    if (SOCD_Clean(BUTTON_SNAP_LEFT | BUTTON_SNAP_RIGHT | BUTTON_SNAP_UP | BUTTON_SNAP_DOWN)
+        != (BUTTON_SNAP_LEFT | BUTTON_SNAP_UP)) {
+        printf("FAIL invalid policy\n");
+        failures++;
+    }
+
+    printf("%u samples checked, %u failures\n", checked, failures);
+    return failures ? 1 : 0;
+}
@@ -26,16 +26,27 @@
  * Changes from the original source:
  *     - deleted unused definitions and functions
  *     - bool BUTTON_IsPressed(BUTTON button)
+ *     - uint16_t BUTTON_Snapshot(void)
+ *     - debounce (BUTTON_DebounceTick(), BUTTON_SetDebounce())
  ********************************************************************/
 
 #include <xc.h>
 #include <stdbool.h>
 #include <buttons.h>
+#include "io_mapping.h"
 
 /*** Button Definitions *********************************************/
 #define BUTTON_PRESSED      0
 #define BUTTON_NOT_PRESSED  1
 
+/*** Debounce *******************************************************/
+/* The release counters are vertical: bit n of releaseCnt[k] is bit k of
+   the ms left until the release of snapshot bit n is accepted, so all 16
+   counters are loaded and counted down with a few mask operations. */
+static uint16_t debounced;                  // filtered snapshot
+static uint16_t releaseCnt[8];              // ms left until a release is accepted
+static uint8_t debounceWindow = BUTTON_DEBOUNCE_DEFAULT_MS;
+
 
 /*********************************************************************
 * Function: bool BUTTON_IsPressed(BUTTON button);
@@ -48,3 +59,82 @@ bool BUTTON_IsPressed(BUTTON button)
     return ( (button == BUTTON_PRESSED) ? true : false);
 }
 
+/*********************************************************************
+* Function: uint16_t BUTTON_Snapshot(void);
+*
+* Overview: Returns all buttons latched from a single read of each port,
+*           with eager-press / deferred-release debouncing
+*
+********************************************************************/
+uint16_t BUTTON_Snapshot(void)
+{
+    uint8_t a = PORTA;
+    uint8_t b = PORTB;
+    uint8_t c = PORTC;
+    uint16_t raw;
+    uint16_t running;
+    uint8_t window = debounceWindow;
+    uint8_t i;
+
+    raw = (uint16_t)((b & 0xF0) | ((a >> 4) & 0x03)) << 8;
+    raw |= (uint8_t)(c & 0xFC);
+
+    // buttons are active low
+    raw = (uint16_t)(~raw & BUTTON_SNAP_MASK);
+
+    // eager press: accepted on the first edge, and the release counter
+    // of every pressed button restarts at debounceWindow
+    debounced |= raw;
+    running = 0;
+    for(i = 0; i < 8; i++, window >>= 1)
+    {
+        releaseCnt[i] &= (uint16_t)~raw;
+        if(window & 1)
+        {
+            releaseCnt[i] |= raw;
+        }
+        running |= releaseCnt[i];
+    }
+
+    // deferred release: accepted once its counter has run out, after
+    // debounceWindow ms of stable release
+    debounced &= (uint16_t)(raw | running);
+
+    return debounced;
+}
+
+/*********************************************************************
+* Function: void BUTTON_DebounceTick(void);
+*
+* Overview: Advances the debounce time base by 1ms
+*
+********************************************************************/
+void BUTTON_DebounceTick(void)
+{
+    uint16_t borrow = 0;
+    uint8_t i;
+
+    // count down every running counter at once (vertical decrement)
+    for(i = 0; i < 8; i++)
+    {
+        borrow |= releaseCnt[i];
+    }
+    for(i = 0; i < 8; i++)
+    {
+        uint16_t cnt = releaseCnt[i];
+
+        releaseCnt[i] = cnt ^ borrow;
+        borrow &= (uint16_t)~cnt;
+    }
+}
+
+/*********************************************************************
+* Function: void BUTTON_SetDebounce(uint8_t ms);
+*
+* Overview: Sets the release filter window
+*
+********************************************************************/
+void BUTTON_SetDebounce(uint8_t ms)
+{
+    debounceWindow = ms;
+}
@@ -26,9 +26,12 @@
  * Changes from the original source:
  *     - Button Definitions
  *     - bool BUTTON_IsPressed(BUTTON button)
+ *     - uint16_t BUTTON_Snapshot(void)
+ *     - debounce (BUTTON_DebounceTick(), BUTTON_SetDebounce())
  ********************************************************************/
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #ifndef BUTTONS_H
 #define BUTTONS_H
@@ -36,6 +39,8 @@
 /*** Button Definitions *********************************************/
 typedef bool BUTTON ;
 
+#define BUTTON_DEBOUNCE_DEFAULT_MS  5   // default release filter window (ms)
+
 /*********************************************************************
 * Function: bool BUTTON_IsPressed(BUTTON button);
 *
@@ -54,5 +59,44 @@ typedef bool BUTTON ;
 ********************************************************************/
 bool BUTTON_IsPressed(BUTTON button);
 
+/*********************************************************************
+* Function: uint16_t BUTTON_Snapshot(void);
+*
+* Overview: Latches PORTA, PORTB and PORTC once and returns every
+*           button as one packed snapshot, so that all buttons in a
+*           report are sampled at the same instant.
+*           The snapshot is debounced: a press is reported on the first
+*           sample it is seen (no added latency), a release only after
+*           the button has stayed released for the debounce window.
+*
+* PreCondition: None
+*
+* Input: None
+*
+* Output: Packed button bits (BUTTON_SNAP_xxx in io_mapping.h).
+*         1 if pressed; 0 if not pressed.
+*
+********************************************************************/
+uint16_t BUTTON_Snapshot(void);
+
+/*********************************************************************
+* Function: void BUTTON_DebounceTick(void);
+*
+* Overview: Advances the debounce time base by 1ms.
+*           Call this on every USB SOF.
+*
+********************************************************************/
+void BUTTON_DebounceTick(void);
+
+/*********************************************************************
+* Function: void BUTTON_SetDebounce(uint8_t ms);
+*
+* Overview: Sets the release filter window.
+*
+* Input: uint8_t ms - window in ms (0 = no filtering)
+*
+********************************************************************/
+void BUTTON_SetDebounce(uint8_t ms);
+
 
 #endif //BUTTONS_H
@@ -22,6 +22,14 @@ please contact mla_licensing@microchip.com
  * 
  * Changes from the original source:
  *     - APP_DeviceJoystickTasks(void)
+ *     - report-on-change with keep-alive
+ *     - USB_INTERRUPT mode support
+ *     - SOF synchronized sampling
+ *     - deferred mapping flash commit
+ *     - HID SET_IDLE idle rate support
+ *     - runtime-selectable descriptor personality
+ *     - press-to-USB latency instrumentation
+ *     - EP0 buffer size option (dual-port RAM layout check)
  *     - delete unused sentences
  ********************************************************************/
 
@@ -33,9 +41,45 @@ please contact mla_licensing@microchip.com
 #include "usb_device_hid.h"
 //#include "app_led_usb_status.h"
 #include "my_app_device_gamepad.h"
+#include "mapping.h"
+#include "usb_personality.h"
+#include "latency.h"
 #include "stdint.h"
+#include <string.h>
 
-USB_VOLATILE USB_HANDLE lastTransmission = 0;
+/* The EP0 buffers end before joystick_input, which ends in the dual-port RAM */
+#if (USB_EP0_BUFF_SIZE != 8) && (USB_EP0_BUFF_SIZE != 16) && (USB_EP0_BUFF_SIZE != 32) && (USB_EP0_BUFF_SIZE != 64)
+    #error "USB_EP0_BUFF_SIZE must be 8, 16, 32 or 64"
+#endif
+#if (CTRL_TRF_DATA_ADDR + USB_EP0_BUFF_SIZE) > JOYSTICK_DATA_ADDR
+    #error "EP0 buffers overlap joystick_input, move JOYSTICK_DATA_ADDRESS"
+#endif
+#if (JOYSTICK_DATA_ADDR + 8) > 0x2200
+    #error "joystick_input is outside the USB dual-port RAM"
+#endif
+
+/* EP1 IN report: only one is armed at a time, joystick_input is its only buffer */
+static USB_VOLATILE USB_HANDLE txHandle;
+static bool txArmed;                // armed, not picked up yet
+static uint8_t txSampleStamp;       // Timer0 when the report was sampled
+
+/* Report-on-change: copy of the last report armed on the IN endpoint */
+static INPUT_CONTROLS lastSentReport;
+static INPUT_CONTROLS lastBuiltReport;  // edge detection for the latency statistics
+static uint16_t lastSentTime;       // 1ms tick of the last transmission
+static uint16_t lastSkipTime;       // 1ms tick of the last counted skip
+static bool forceSend;              // send the next report unconditionally
+static uint16_t skippedReports;     // number of frames not transmitted
+
+/* HID idle rate requested by the host (SET_IDLE, 4ms units, 0 = infinite) */
+static bool hostIdleSet;            // SET_IDLE received since configuration
+static uint8_t hostIdleRate;
+
+/* SOF synchronized sampling (all times in free-running Timer0 ticks) */
+static volatile uint8_t sofStamp;   // Timer0 at the last SOF
+static volatile bool sofPending;    // SOF seen, report for this frame not built yet
+static uint8_t reportAge;           // sample -> host pickup of the last report
+static uint8_t pickupPhase;         // SOF -> host pickup of the last report
 
 /*********************************************************************
 * Function: void APP_DeviceJoystickInitialize(void);
@@ -51,9 +95,13 @@ USB_VOLATILE USB_HANDLE lastTransmission = 0;
 ********************************************************************/
 void APP_DeviceJoystickInitialize(void)
 {  
-    //initialize the variable holding the handle for the last
-    // transmission
-    lastTransmission = 0;
+    //initialize the report handle
+    txHandle = 0;
+    txArmed = false;
+    forceSend = true;
+    Latency_Reset();
+    sofPending = false;
+    hostIdleSet = false;
 
     //enable the HID endpoint
     USBEnableEndpoint(JOYSTICK_EP,USB_IN_ENABLED|USB_HANDSHAKE_ENABLED|USB_DISALLOW_SETUP);
@@ -61,6 +109,118 @@ void APP_DeviceJoystickInitialize(void)
     App_DeviceGamepadInit();
 }//end UserInit
 
+/*********************************************************************
+* Function: static void APP_DeviceJoystickSend(uint16_t buttons);
+*
+* Overview: Builds and arms the next input report once the host has
+*   picked up the previous one.
+*
+* Input: buttons - BUTTON_Snapshot() of this main loop pass
+*
+********************************************************************/
+static void APP_DeviceJoystickSend(uint16_t buttons)
+{
+    uint8_t t0 = TMR0;
+    uint8_t phase;
+    uint8_t period;
+    bool onChange;
+    bool edge;
+
+    //Report picked up by the host: record how old it was
+    if(txArmed)
+    {
+        //Wait until the report in flight has been picked up
+        if(HIDTxHandleBusy(txHandle))
+        {
+            return;
+        }
+        txArmed = false;
+        reportAge = (uint8_t)(t0 - txSampleStamp);
+        pickupPhase = (uint8_t)(t0 - sofStamp);
+        Latency_Pickup();
+        Latency_Update();
+    }
+
+    //SOF synchronized sampling: sample once per frame, sofPhase Timer0
+    //ticks after SOF, just before the host is expected to poll EP1.
+    phase = Mapping_GetSOFPhase();
+    if(phase != 0)
+    {
+        if(!sofPending || ((uint8_t)(t0 - sofStamp) < phase))
+        {
+            return;
+        }
+        sofPending = false;
+    }
+
+    //Once the host has issued SET_IDLE its idle rate takes over from the
+    //configured keep-alive (both are in 4ms units).  An idle rate of 0 is
+    //infinite: unchanged reports are never repeated.  A keep-alive of 0
+    //keeps the legacy behaviour of sending every frame.
+    if(hostIdleSet)
+    {
+        period = hostIdleRate;
+        onChange = true;
+    }
+    else
+    {
+        period = Mapping_GetKeepAlive();
+        onChange = (period != 0);
+    }
+    Latency_Sample();
+
+    App_DeviceGamepadAct(&joystick_input, buttons);
+
+    //Convert to the report format of the active personality
+    if(USBPersonality->pack != NULL)
+    {
+        USBPersonality->pack(joystick_input.val);
+    }
+
+    //A report that differs from the previous one carries an input edge
+    edge = (memcmp(&joystick_input, &lastBuiltReport, sizeof(joystick_input)) != 0);
+    if(edge)
+    {
+        lastBuiltReport = joystick_input;
+    }
+
+    //Report-on-change: only arm the endpoint when the report differs
+    //from the last one sent, or when the repeat period elapsed.
+    if(onChange)
+    {
+        uint16_t now = (uint16_t)USBGet1msTickCount();
+
+        if(!forceSend
+            && (memcmp(&joystick_input, &lastSentReport, sizeof(joystick_input)) == 0)
+            && ((period == 0) || ((uint16_t)(now - lastSentTime) < ((uint16_t)period << 2))))
+        {
+            //count at most one skip per USB frame
+            if(now != lastSkipTime)
+            {
+                lastSkipTime = now;
+                skippedReports++;
+            }
+            //Nothing to send this time: also a safe point for the flash commit
+            Mapping_Tasks();
+            return;
+        }
+
+        lastSentReport = joystick_input;
+        lastSentTime = now;
+        forceSend = false;
+    }
+
+    //Send the report over USB to the host.
+    txHandle = HIDTxPacket(JOYSTICK_EP, joystick_input.val, USBPersonality->inputSize);
+    txArmed = true;
+    txSampleStamp = t0;
+    Latency_Armed(edge);
+
+    //A report has just been armed, so this is the safest point to stall
+    //for a pending mapping flash erase/write step.
+    Mapping_Tasks();
+}
+
 /*********************************************************************
 * Function: void APP_DeviceJoystickTasks(void);
 *
@@ -77,6 +237,7 @@ void APP_DeviceJoystickInitialize(void)
 ********************************************************************/
 void APP_DeviceJoystickTasks(void)
 {  
+    uint16_t buttons;
 
     /* If the USB device isn't configured yet, we can't really do anything
      * else since we don't have a host to talk to.  So jump back to the
@@ -97,21 +258,76 @@ void APP_DeviceJoystickTasks(void)
         return;
     }
 
-    //If the last transmission is complete
-    if(!HIDTxHandleBusy(lastTransmission))
-    {
-        App_DeviceGamepadAct(&joystick_input);
-        
-        //Send the packet over USB to the host.
-        lastTransmission = HIDTxPacket(JOYSTICK_EP, (uint8_t*)&joystick_input, sizeof(joystick_input));
+    /* In USB_INTERRUPT mode the ISR may re-initialize the app (EVENT_CONFIGURED),
+     * rewrite the mapping (SET_REPORT) or read the status counters (GET_REPORT)
+     * at any time.  Keep the USB interrupt masked while the mode flags, the
+     * mapping tables, joystick_input and the EP1 BDT are in use, so that
+     * every report is built from one coherent state.  These macros do
+     * nothing in USB_POLLING mode. */
+    USBMaskInterrupts();
 
-        // change left cross key function
-        ChangeSWMode_Button_Select();
+    // one button snapshot per pass, for the combos and the report
+    buttons = BUTTON_Snapshot();
 
-        // change left cross key function
-        ChangeSWMode_Button_Start();
-    }
+    // change button mapping / left cross key function (non-blocking)
+    App_DeviceGamepadModeTasks(buttons);
+
+    APP_DeviceJoystickSend(buttons);
+
+    USBUnmaskInterrupts();
     
 }//end ProcessIO
 
+/*********************************************************************
+* Function: void APP_DeviceJoystickSOFHandler(void);
+*
+* Overview: Time stamps the USB start of frame for SOF synchronized
+*   sampling.  Call this on every EVENT_SOF.
+*
+********************************************************************/
+void APP_DeviceJoystickSOFHandler(void)
+{
+    sofStamp = TMR0;
+    sofPending = true;
+    Latency_SOF();
+}
+
+/*********************************************************************
+* Function: void APP_DeviceJoystickSetIdle(uint8_t reportId, uint8_t idleRate);
+*
+* Overview: Records the idle rate of a HID SET_IDLE request for the
+*   joystick interface.  Called by the HID stack through
+*   USB_DEVICE_HID_IDLE_RATE_CALLBACK.
+*
+********************************************************************/
+void APP_DeviceJoystickSetIdle(uint8_t reportId, uint8_t idleRate)
+{
+    //The joystick report has no report ID, so the idle rate applies to it
+    (void)reportId;
+
+    //The mapping interface has no IN endpoint, so its idle rate is ignored
+    if(SetupPkt.bIntfID != HID_INTF_ID)
+    {
+        return;
+    }
+
+    hostIdleRate = idleRate;
+    hostIdleSet = true;
+}
+
+/*********************************************************************
+* Function: void APP_DeviceJoystickGetStatus(uint8_t* status);
+*
+* Overview: Copies the report scheduler status for the mapping
+*   GET_REPORT.
+*
+********************************************************************/
+void APP_DeviceJoystickGetStatus(uint8_t* status)
+{
+    status[0] = pickupPhase;
+    status[1] = reportAge;
+    status[2] = (uint8_t)skippedReports;
+    status[3] = (uint8_t)(skippedReports >> 8);
+}
+
 #endif
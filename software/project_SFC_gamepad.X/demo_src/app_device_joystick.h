@@ -22,6 +22,7 @@ please contact mla_licensing@microchip.com
  * 
  * Changes from the original source:
  *     - moved DECLARATIONS, TYPE DEFINITIONS and VARIABLES to this file from app_device_joystick.c.
+ *     - vendor byte for the Switch personality
  ********************************************************************/
 
 #include "stdint.h"
@@ -74,8 +75,9 @@ typedef union _INTPUT_CONTROLS_TYPEDEF
             uint8_t Z;
             uint8_t Rz;            
         } analog_stick;
+        uint8_t vendor;     // Switch personality only (not sent by the generic one)
     } members;
-    uint8_t val[7];
+    uint8_t val[8];
 } INPUT_CONTROLS;
 
 
@@ -142,3 +144,57 @@ void APP_DeviceJoystickStart(void);
 *
 ********************************************************************/
 void APP_DeviceJoystickTasks(void);
+
+/*********************************************************************
+* Function: void APP_DeviceJoystickSOFHandler(void);
+*
+* Overview: Time stamps the USB start of frame for SOF synchronized
+*   sampling.
+*
+* PreCondition: None
+*
+* Input: None
+*
+* Output: None
+*
+* Note: Call this on every EVENT_SOF.
+*
+********************************************************************/
+void APP_DeviceJoystickSOFHandler(void);
+
+/*********************************************************************
+* Function: void APP_DeviceJoystickSetIdle(uint8_t reportId, uint8_t idleRate);
+*
+* Overview: Records the idle rate of a HID SET_IDLE request for the
+*   joystick report scheduler.
+*
+* PreCondition: None
+*
+* Input: uint8_t reportId - report ID of the request (unused, the
+*          joystick has a single report)
+*        uint8_t idleRate - idle period in 4ms units (0 = infinite)
+*
+* Output: None
+*
+* Note: Called by the HID stack through USB_DEVICE_HID_IDLE_RATE_CALLBACK.
+*
+********************************************************************/
+void APP_DeviceJoystickSetIdle(uint8_t reportId, uint8_t idleRate);
+
+/*********************************************************************
+* Function: void APP_DeviceJoystickGetStatus(uint8_t* status);
+*
+* Overview: Copies the report scheduler status for the mapping
+*   GET_REPORT.
+*
+* PreCondition: None
+*
+* Input: uint8_t* status - 4 byte buffer
+*   [0] SOF -> host pickup of the last report (Timer0 ticks)
+*   [1] sample -> host pickup of the last report (Timer0 ticks)
+*   [2-3] frames skipped by report-on-change (little endian)
+*
+* Output: None
+*
+********************************************************************/
+void APP_DeviceJoystickGetStatus(uint8_t* status);
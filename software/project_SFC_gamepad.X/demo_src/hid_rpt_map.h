@@ -1,19 +1,39 @@
 #ifndef HID_RPT_MAP_H
 #define HID_RPT_MAP_H
 
-#define HID_MAP_RPT_DESC_SIZE 21   // レポートディスクリプタのサイズ
+#include "mapping.h"
+#include "latency.h"
+
+#define HID_MAP_RPT_DESC_SIZE 47   // レポートディスクリプタのサイズ
 #define HID_MAP_EP_BUF_SIZE   64   // USB EP送受信バッファのサイズ
 
-const struct{uint8_t report[HID_MAP_RPT_DESC_SIZE];}hid_map_rpt={{ 
+/* Interface 1 のフィーチャーレポート。レポート ID を 1 つでも使う場合は全レポートに
+   0 以外の ID が必要 (ID 0 との混在は不可)。ID 1, 2 は ID + 63 バイトの 64 バイト、
+   ID 3 (タグ) は ID + タグ + 最長の値の MAP_TAG_RPT_LEN バイト、
+   ID 4 (コマンド) は最長のコマンドの MAP_CMD_RPT_LEN バイト */
+static const struct{uint8_t report[HID_MAP_RPT_DESC_SIZE];}hid_map_rpt={{ 
   0x06,0x00,0xFF,            // Usage Page (Vendor Defined Page 1, 0xFF00)
   0x09,0x01,                 // Usage (Vendor Usage 1)
   0xA1,0x01,                 // Collection (Application)
   0x15,0x00,                 //   Logical Minimum (0)
   0x26,0xFF,0x00,           //   Logical Maximum (255)
   0x75,0x08,                 //   Report Size (8)
-  0x95,0x40,                 //   Report Count (64) - for 64 bytes total including Report ID
+  0x85,MAP_REPORT_ID,        //   Report ID (1): mapping
+  0x95,0x3F,                 //   Report Count (63) - 64 bytes with the Report ID
   0x09,0x01,                 //   Usage (Vendor Usage 1)
   0xB1,0x02,                 //   Feature (Data, Variable, Absolute)
+  0x85,LATENCY_REPORT_ID,    //   Report ID (2): latency statistics
+  0x95,0x3F,                 //   Report Count (63)
+  0x09,0x02,                 //   Usage (Vendor Usage 2)
+  0xB1,0x02,                 //   Feature (Data, Variable, Absolute)
+  0x85,MAP_TAG_REPORT_ID,    //   Report ID (3): mapping tag
+  0x95,MAP_TAG_RPT_LEN - 1,  //   Report Count (16)
+  0x09,0x03,                 //   Usage (Vendor Usage 3)
+  0xB1,0x02,                 //   Feature (Data, Variable, Absolute)
+  0x85,MAP_CMD_REPORT_ID,    //   Report ID (4): mapping command
+  0x95,MAP_CMD_RPT_LEN - 1,  //   Report Count (26)
+  0x09,0x04,                 //   Usage (Vendor Usage 4)
+  0xB1,0x02,                 //   Feature (Data, Variable, Absolute)
   0xC0                       //   End Collection
 }};
 
@@ -25,14 +25,19 @@ please contact mla_licensing@microchip.com
 #define USBCFG_H
 
 #include <usb_ch9.h>
+#include "usb_personality.h"
 
 /** DEFINITIONS ****************************************************/
-#define USB_EP0_BUFF_SIZE		8	// Valid Options: 8, 16, 32, or 64 bytes.
-								// Using larger options take more SRAM, but
-								// does not provide much advantage in most types
-								// of applications.  Exceptions to this, are applications
-								// that use EP0 IN or OUT for sending large amounts of
-								// application related data.
+//EP0 packet size: 8 (default) or 64.  The 64 byte mapping feature report
+//and most descriptors then take a single DATA stage instead of up to 9.
+//The EP0 buffers sit in the USB dual-port RAM (0x2000-0x21FF) after the BDT:
+//    EP0 size  BDT            SetupPkt       CtrlTrfData    joystick_input
+//    8         0x2000-0x201F  0x2020-0x2027  0x2028-0x202F  0x2050 (fixed_address_memory.h)
+//    64        0x2000-0x201F  0x2020-0x205F  0x2060-0x209F  0x20A0
+//Add USB_EP0_BUFF_SIZE=64 to the XC8 "Define macros" project option to build it.
+#if !defined(USB_EP0_BUFF_SIZE)
+    #define USB_EP0_BUFF_SIZE	8	// Valid Options: 8, 16, 32, or 64 bytes.
+#endif
 									
 #define USB_MAX_NUM_INT     	2   //Set this number to match the maximum interface number used in the descriptors for this firmware project
 #define USB_MAX_EP_NUMBER	    1   //Set this number to match the maximum endpoint number used in the descriptors for this firmware project
@@ -40,13 +45,15 @@ please contact mla_licensing@microchip.com
 //Device descriptor - if these two definitions are not defined then
 //  a const USB_DEVICE_DESCRIPTOR variable by the exact name of device_dsc
 //  must exist.
-#define USB_USER_DEVICE_DESCRIPTOR &device_dsc
+//  The descriptors actually served come from the active personality
+//  (usb_personality.h); device_dsc is still needed for its size.
+#define USB_USER_DEVICE_DESCRIPTOR (USBPersonality->device)
 #define USB_USER_DEVICE_DESCRIPTOR_INCLUDE extern const USB_DEVICE_DESCRIPTOR device_dsc
 
 //Configuration descriptors - if these two definitions do not exist then
 //  a const BYTE *const variable named exactly USB_CD_Ptr[] must exist.
-#define USB_USER_CONFIG_DESCRIPTOR USB_CD_Ptr
-#define USB_USER_CONFIG_DESCRIPTOR_INCLUDE extern const uint8_t *const USB_CD_Ptr[]
+#define USB_USER_CONFIG_DESCRIPTOR (USBPersonality->config)
+#define USB_USER_CONFIG_DESCRIPTOR_INCLUDE extern const USB_PERSONALITY *USBPersonality
 
 
 //------------------------------------------------------------------------------
@@ -76,9 +83,14 @@ please contact mla_licensing@microchip.com
 //When the USB_POLLING mode is selected, the USB stack main task handler
 //(ex: USBDeviceTasks()) must be called periodically by the application firmware
 //at a minimum rate as described in the inline code comments in usb_device.c.
+//
+//This project builds in USB_POLLING mode by default.  To build the interrupt
+//driven configuration, add USB_INTERRUPT to the XC8 "Define macros" project
+//option instead of editing this file.
 //------------------------------------------------------
-#define USB_POLLING
-//#define USB_INTERRUPT
+#if !defined(USB_INTERRUPT)
+    #define USB_POLLING
+#endif
 //------------------------------------------------------------------------------
 
 /* Parameter definitions are defined in usb_device.h */
@@ -160,6 +172,7 @@ please contact mla_licensing@microchip.com
 #define USB_USE_HID
 #define USER_SET_REPORT_HANDLER  HIDFeatureReceive
 #define USER_GET_REPORT_HANDLER  HIDFeatureReceive
+#define USB_DEVICE_HID_IDLE_RATE_CALLBACK(reportId, idleRate)  APP_DeviceJoystickSetIdle(reportId, idleRate)
 
 /** ENDPOINTS ALLOCATION *******************************************/
 
@@ -170,7 +183,8 @@ please contact mla_licensing@microchip.com
 #define HID_INT_IN_EP_SIZE      64
 #define HID_NUM_OF_DSC          1   // Number of HID class descriptors per interface
 #define HID_RPT01_SIZE          74      //number of bytes in HID report descriptor (counted exactly)
-#define HID_MAP_RPT_DESC_SIZE   21      // size of the mapping Feature report descriptor (hid_rpt_map.h)
+#define HID_RPT_SWITCH_SIZE     86      //number of bytes in the Switch personality report descriptor
+#define HID_MAP_RPT_DESC_SIZE   47      // size of the mapping Feature report descriptor (hid_rpt_map.h)
 #define HID_MAP_EP_BUF_SIZE     64      // size of the mapping Feature report EP buffer
 
 /** DEFINITIONS ****************************************************/
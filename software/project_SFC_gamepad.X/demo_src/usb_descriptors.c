@@ -144,6 +144,8 @@ state according to the definition in the USB specification.
  *     - PID
  *     - Product string descriptor
  *     - hid_rpt01
+ *     - runtime-selectable descriptor personalities
+ *     - bus powered with remote wakeup (_RWU instead of _SELF)
  ********************************************************************/
 
 /** INCLUDES *******************************************************/
@@ -151,6 +153,8 @@ state according to the definition in the USB specification.
 #include "usb_device_hid.h"
 #include "my_usb_pid.h"
 #include "hid_rpt_map.h"
+#include "usb_personality.h"
+#include "io_mapping.h"
 
 /** CONSTANTS ******************************************************/
 #if defined(COMPILER_MPLAB_C18)
@@ -176,6 +180,25 @@ const USB_DEVICE_DESCRIPTOR device_dsc=
     0x01                    // Number of possible configurations
 };
 
+/* Device Descriptor (Switch personality) */
+const USB_DEVICE_DESCRIPTOR device_dsc_switch=
+{
+    0x12,    // Size of this descriptor in bytes
+    USB_DESCRIPTOR_DEVICE,                // DEVICE descriptor type
+    0x0200,                 // USB Spec Release Number in BCD format
+    0x00,                   // Class Code
+    0x00,                   // Subclass code
+    0x00,                   // Protocol code
+    USB_EP0_BUFF_SIZE,      // Max packet size for EP0, see usb_config.h
+    0x0F0D,                 // Vendor ID (HORI)
+    0x0092,                 // Product ID (Pokken Tournament Pro Pad)
+    0x0100,                 // Device release number in BCD format
+    0x01,                   // Manufacturer string index
+    0x02,                   // Product string index
+    0x00,                   // Device serial number string index
+    0x01                    // Number of possible configurations
+};
+
 /* Configuration 1 Descriptor */
 const uint8_t configDescriptor1[]={        
     /* Configuration Descriptor */    
@@ -185,7 +208,7 @@ const uint8_t configDescriptor1[]={
     2,                      // Number of interfaces in this cfg
     1,                      // Index value of this configuration
     0,                      // Configuration string index
-    _DEFAULT | _SELF,               // Attributes, see usb_device.h
+    _DEFAULT | _RWU,                // Attributes, see usb_device.h (bus powered, remote wakeup)
     50,                     // Max power consumption (2X mA)
 
     /* Interface Descriptor (Interface 0: GamePad) */    
@@ -239,6 +262,68 @@ const uint8_t configDescriptor1[]={
 };
 
 
+/* Configuration 1 Descriptor (Switch personality) */
+const uint8_t configDescriptorSwitch[]={        
+    /* Configuration Descriptor */    
+    0x09,//sizeof(USB_CFG_DSC),    // Size of this descriptor in bytes     
+    USB_DESCRIPTOR_CONFIGURATION,                // CONFIGURATION descriptor type      
+    DESC_CONFIG_WORD(0x0034),                   // Total length of data for this cfg
+    2,                      // Number of interfaces in this cfg
+    1,                      // Index value of this configuration
+    0,                      // Configuration string index
+    _DEFAULT | _RWU,                // Attributes, see usb_device.h (bus powered, remote wakeup)
+    50,                     // Max power consumption (2X mA)
+
+    /* Interface Descriptor (Interface 0: GamePad) */    
+    0x09,//sizeof(USB_INTF_DSC),   // Size of this descriptor in bytes    
+    USB_DESCRIPTOR_INTERFACE,               // INTERFACE descriptor type    
+    0,                      // Interface Number    
+    0,                      // Alternate Setting Number    
+    1,                      // Number of endpoints in this intf    
+    HID_INTF,               // Class code    
+    0,     // Subclass code    
+    0,     // Protocol code    
+    0,                      // Interface string index
+
+    /* HID Class-Specific Descriptor */
+    0x09,//sizeof(USB_HID_DSC)+3,    // Size of this descriptor in bytes RRoj hack
+    DSC_HID,                // HID descriptor type
+    DESC_CONFIG_WORD(0x0111),                 // HID Spec Release Number in BCD format (1.11)
+    0x00,                   // Country Code (0x00 for Not supported)
+    HID_NUM_OF_DSC,         // Number of class descriptors, see usbcfg.h
+    DSC_RPT,                // Report descriptor type
+    DESC_CONFIG_WORD(HID_RPT_SWITCH_SIZE),   // Size of the report descriptor
+    
+    /* Endpoint Descriptor */
+    0x07,/*sizeof(USB_EP_DSC)*/
+    USB_DESCRIPTOR_ENDPOINT,    //Endpoint Descriptor
+    JOYSTICK_EP | _EP_IN,            //EndpointAddress
+    _INTERRUPT,                       //Attributes
+    DESC_CONFIG_WORD(64),        //size
+    0x01,                        //Interval
+
+    /* Interface Descriptor (Interface 1: Vendor Feature) */    
+    0x09,//sizeof(USB_INTF_DSC),   // Size of this descriptor in bytes    
+    USB_DESCRIPTOR_INTERFACE,               // INTERFACE descriptor type    
+    1,                      // Interface Number    
+    0,                      // Alternate Setting Number    
+    0,                      // Number of endpoints in this intf    
+    HID_INTF,               // Class code    
+    0xFF,                   // Subclass code - Vendor defined    
+    0xFF,                   // Protocol code - Vendor defined    
+    0,                      // Interface string index
+
+    /* HID Class-Specific Descriptor */
+    0x09,//sizeof(USB_HID_DSC)+3,    // Size of this descriptor in bytes
+    DSC_HID,                // HID descriptor type
+    DESC_CONFIG_WORD(0x0111),                 // HID Spec Release Number in BCD format (1.11)
+    0x00,                   // Country Code (0x00 for Not supported)
+    HID_NUM_OF_DSC,         // Number of class descriptors, see usbcfg.h
+    DSC_RPT,                // Report descriptor type
+    DESC_CONFIG_WORD(HID_MAP_RPT_DESC_SIZE),   // Size of the report descriptor
+    // No endpoint descriptors for Interface 1
+};
+
 //Language code string descriptor
 const struct{uint8_t bLength;uint8_t bDscType;uint16_t string[1];}sd000={
 sizeof(sd000),USB_DESCRIPTOR_STRING,{0x0409
@@ -263,6 +348,11 @@ const uint8_t *const USB_CD_Ptr[]=
     (const uint8_t *const)&configDescriptor1
 };
 
+const uint8_t *const USB_CD_Ptr_Switch[]=
+{
+    (const uint8_t *const)&configDescriptorSwitch
+};
+
 //Array of string descriptors
 const uint8_t *const USB_SD_Ptr[]=
 {
@@ -310,5 +400,102 @@ const struct{uint8_t report[HID_RPT01_SIZE];}hid_rpt01={{
   0xC0              //END_COLLECTION
 }
 };
+
+const struct{uint8_t report[HID_RPT_SWITCH_SIZE];}hid_rpt_switch={{
+  0x05,0x01,        //USAGE_PAGE (Generic Desktop)
+  0x09,0x05,        //USAGE (Game Pad)
+  0xA1,0x01,        //COLLECTION (Application)
+  0x15,0x00,        //  LOGICAL_MINIMUM(0)
+  0x25,0x01,        //  LOGICAL_MAXIMUM(1)
+  0x35,0x00,        //  PHYSICAL_MINIMUM(0)
+  0x45,0x01,        //  PHYSICAL_MAXIMUM(1)
+  0x75,0x01,        //  REPORT_SIZE(1)
+  0x95,0x10,        //  REPORT_COUNT(16)
+  0x05,0x09,        //  USAGE_PAGE(Button)
+  0x19,0x01,        //  USAGE_MINIMUM(Button 1)
+  0x29,0x10,        //  USAGE_MAXIMUM(Button 16)
+  0x81,0x02,        //  INPUT(Data,Var,Abs)
+  0x05,0x01,        //  USAGE_PAGE(Generic Desktop)
+  0x25,0x07,        //  LOGICAL_MAXIMUM(7)
+  0x46,0x3B,0x01,   //  PHYSICAL_MAXIMUM(315)
+  0x75,0x04,        //  REPORT_SIZE(4)
+  0x95,0x01,        //  REPORT_COUNT(1)
+  0x65,0x14,        //  UNIT(Eng Rot:Angular Pos)
+  0x09,0x39,        //  USAGE(Hat Switch)
+  0x81,0x42,        //  INPUT(Data,Var,Abs,Null)
+  0x65,0x00,        //  UNIT(None)
+  0x95,0x01,        //  REPORT_COUNT(1)
+  0x81,0x01,        //  INPUT(Cnst,Ary,Abs)
+  0x26,0xFF,0x00,   //  LOGICAL_MAXIMUM(255)
+  0x46,0xFF,0x00,   //  PHYSICAL_MAXIMUM(255)
+  0x09,0x30,        //  USAGE(X)
+  0x09,0x31,        //  USAGE(Y)
+  0x09,0x32,        //  USAGE(Z)
+  0x09,0x35,        //  USAGE(Rz)
+  0x75,0x08,        //  REPORT_SIZE(8)
+  0x95,0x04,        //  REPORT_COUNT(4)
+  0x81,0x02,        //  INPUT(Data,Var,Abs)
+  0x06,0x00,0xFF,   //  USAGE_PAGE(Vendor Defined 0xFF00)
+  0x09,0x20,        //  USAGE(0x20)
+  0x95,0x01,        //  REPORT_COUNT(1)
+  0x81,0x02,        //  INPUT(Data,Var,Abs)
+  0x0A,0x21,0x26,   //  USAGE(0x2621)
+  0x95,0x08,        //  REPORT_COUNT(8)
+  0x91,0x02,        //  OUTPUT(Data,Var,Abs)
+  0xC0              //END_COLLECTION
+}
+};
+
+/* Descriptor personalities, indexed by PERSONALITY_* */
+const USB_PERSONALITY USBPersonalities[PERSONALITY_COUNT]=
+{
+    /* PERSONALITY_GENERIC */
+    {
+        (const uint8_t*)&device_dsc,
+        USB_CD_Ptr,
+        (const uint8_t*)&hid_rpt01,
+        HID_RPT01_SIZE,
+        7,                      // buttons(2) + hat(1) + X/Y/Z/Rz(4)
+        BUTTON_SNAP_SELECT,
+        NULL
+    },
+    /* PERSONALITY_SWITCH */
+    {
+        (const uint8_t*)&device_dsc_switch,
+        USB_CD_Ptr_Switch,
+        (const uint8_t*)&hid_rpt_switch,
+        HID_RPT_SWITCH_SIZE,
+        8,                      // buttons(2) + hat(1) + X/Y/Z/Rz(4) + vendor(1)
+        BUTTON_SNAP_START,
+        App_DeviceGamepadPackSwitch
+    }
+};
+
+const USB_PERSONALITY *USBPersonality = &USBPersonalities[PERSONALITY_GENERIC];
+
+/*********************************************************************
+* Function: void USBPersonalitySelect(uint8_t stored, uint16_t buttons);
+*
+* Overview: Selects the descriptor personality served during
+*   enumeration.  A personality whose boot button is held at plug-in
+*   overrides the one stored in the HEF map.
+*
+* PreCondition: Call before USBDeviceInit().
+*
+********************************************************************/
+void USBPersonalitySelect(uint8_t stored, uint16_t buttons)
+{
+    uint8_t id = (stored < PERSONALITY_COUNT) ? stored : PERSONALITY_GENERIC;
+
+    for(uint8_t i = 0; i < PERSONALITY_COUNT; i++)
+    {
+        if(buttons & USBPersonalities[i].bootButton)
+        {
+            id = i;
+            break;
+        }
+    }
+    USBPersonality = &USBPersonalities[id];
+}
 /** EOF usb_descriptors.c ***************************************************/
 
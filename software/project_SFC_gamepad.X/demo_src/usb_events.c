@@ -22,6 +22,7 @@ please contact mla_licensing@microchip.com
  * 
  * Changes from the original source:
  *     - deleted unused header file inclusion
+ *     - latency statistics feature report
  ********************************************************************/
 
 /** INCLUDES *******************************************************/
@@ -35,6 +36,7 @@ please contact mla_licensing@microchip.com
 #include "app_device_joystick.h"
 #include "mapping.h"
 #include "demo_src/hid_rpt_map.h"
+#include "latency.h"
 
 /*******************************************************************
  * Function:        bool USER_USB_CALLBACK_EVENT_HANDLER(
@@ -59,15 +61,29 @@ please contact mla_licensing@microchip.com
  *******************************************************************/
 bool USER_USB_CALLBACK_EVENT_HANDLER(USB_EVENT event, void *pdata, uint16_t size)
 {
+    (void)size;     // no event handled here needs the size
+
     switch( (int) event )
     {
         case EVENT_TRANSFER:
+        {
+            /* The host has picked up the joystick report (BDT UOWN cleared) */
+            USTAT_FIELDS stat;
+
+            stat.Val = *(uint8_t*)pdata;
+            if((USBHALGetLastEndpoint(stat) == JOYSTICK_EP) && (USBHALGetLastDirection(stat) == IN_TO_HOST))
+            {
+                Latency_Pickup();
+            }
             break;
+        }
 
         case EVENT_SOF:
-            /* We are using the SOF as a timer to time the LED indicator.  Call
-             * the LED update function here. */
+            /* We are using the SOF as the 1ms time base for button
+             * debouncing, and as the reference for report sampling. */
 //            APP_LEDUpdateUSBStatus();
+            BUTTON_DebounceTick();
+            APP_DeviceJoystickSOFHandler();
             break;
 
         case EVENT_SUSPEND:
@@ -121,25 +137,84 @@ bool USER_USB_CALLBACK_EVENT_HANDLER(USB_EVENT event, void *pdata, uint16_t size
     return true;
 }
 
-// Feature report buffers for two interfaces
-static uint8_t featureBuf[64];            // Interface 0 受信用バッファ
+// Feature report buffer (interface 1)
 static uint8_t mapFeatureBuf[64];         // Interface 1 mapping feature buffer
 
 /* ---------- ② 64B受信し終わったとき自動で呼ばれる ---------- */
 void USBCB_HIDSetReportComplete(void)
 {
-    // Process the mapping data immediately after receiving
+    // Validate and apply the mapping data; the flash write is deferred
+    // to Mapping_Tasks() so that EP0 servicing is not stalled here.
     Mapping_SetFromFeatureReport(mapFeatureBuf, sizeof(mapFeatureBuf));
 
 }
 
+/* ---------- latency statistics SET_REPORT: any data clears them ---------- */
+void USBCB_LatencySetReportComplete(void)
+{
+    Latency_Reset();
+}
+
+/* ---------- tag SET_REPORT: the host sends only the tag it writes ---------- */
+static uint8_t mapRxLength;               // data stage length of the tag SET_REPORT
+
+void USBCB_MapTagSetReportComplete(void)
+{
+    Mapping_SetTagReport(mapFeatureBuf, mapRxLength);
+}
+
+/* ---------- command SET_REPORT: runs the command within the transfer ---------- */
+void USBCB_MapCmdSetReportComplete(void)
+{
+    Mapping_SetCommandReport(mapFeatureBuf, mapRxLength);
+}
+
 /* ---------- SET_REPORT handler for both interfaces ---------- */
 void HIDFeatureReceive(void)
 {
     uint8_t reportID = SetupPkt.W_Value.byte.LB;  // Report ID is in the low byte of wValue
     uint8_t interfaceNum = SetupPkt.W_Index.byte.LB;  // Interface number is in the low byte of wIndex
     
-    if (interfaceNum == 1) {
+    if (interfaceNum == 1 && reportID == LATENCY_REPORT_ID) {
+        // Latency statistics (report ID 2, next to the mapping report ID 1)
+        if (SetupPkt.bRequest == SET_REPORT) {
+            USBEP0Receive(mapFeatureBuf, HID_MAP_EP_BUF_SIZE, USBCB_LatencySetReportComplete);
+        }
+        else if (SetupPkt.bRequest == GET_REPORT) {
+            memset(mapFeatureBuf, 0, sizeof(mapFeatureBuf));
+            Latency_GetAsFeatureReport(mapFeatureBuf);
+            USBEP0SendRAMPtr(mapFeatureBuf, HID_MAP_EP_BUF_SIZE, USB_EP0_INCLUDE_ZERO);
+        }
+    }
+    else if (interfaceNum == 1 && reportID == MAP_TAG_REPORT_ID) {
+        // Mapping tags (report ID 3): short transfers of one tag each
+        if (SetupPkt.bRequest == SET_REPORT) {
+            // USBEP0Receive() completes only after the given length, so wait for wLength.
+            // A SET_REPORT without data is left unclaimed, so the stack stalls it.
+            if (SetupPkt.wLength != 0) {
+                mapRxLength = (SetupPkt.wLength < HID_MAP_EP_BUF_SIZE) ? (uint8_t)SetupPkt.wLength : HID_MAP_EP_BUF_SIZE;
+                USBEP0Receive(mapFeatureBuf, mapRxLength, USBCB_MapTagSetReportComplete);
+            }
+        }
+        else if (SetupPkt.bRequest == GET_REPORT) {
+            memset(mapFeatureBuf, 0, sizeof(mapFeatureBuf));
+            USBEP0SendRAMPtr(mapFeatureBuf, Mapping_GetTagReport(mapFeatureBuf), USB_EP0_INCLUDE_ZERO);
+        }
+    }
+    else if (interfaceNum == 1 && reportID == MAP_CMD_REPORT_ID) {
+        // Mapping commands (report ID 4): applied in RAM, flash only on commit
+        if (SetupPkt.bRequest == SET_REPORT) {
+            // Same as the tag report: stalled without data
+            if (SetupPkt.wLength != 0) {
+                mapRxLength = (SetupPkt.wLength < HID_MAP_EP_BUF_SIZE) ? (uint8_t)SetupPkt.wLength : HID_MAP_EP_BUF_SIZE;
+                USBEP0Receive(mapFeatureBuf, mapRxLength, USBCB_MapCmdSetReportComplete);
+            }
+        }
+        else if (SetupPkt.bRequest == GET_REPORT) {
+            USBEP0SendRAMPtr(mapFeatureBuf, Mapping_GetCommandReport(mapFeatureBuf), USB_EP0_INCLUDE_ZERO);
+        }
+    }
+    else if (interfaceNum == 1 && reportID == MAP_REPORT_ID) {
         // Check if this is SET_REPORT (from host to device)
         if (SetupPkt.bRequest == SET_REPORT) {
             // SET_REPORT - receive data from host via control transfer
@@ -153,6 +228,12 @@ void HIDFeatureReceive(void)
             // Prepare feature report data
             memset(mapFeatureBuf, 0, sizeof(mapFeatureBuf));  // Clear buffer
             Mapping_GetAsFeatureReport(mapFeatureBuf);  // Fill with mapping data
+
+            // Runtime status (not stored in flash)
+            // Byte 59: flash commit status (set by Mapping_GetAsFeatureReport())
+            // Byte 60: SOF -> report pickup, Byte 61: report age at pickup (Timer0 ticks)
+            // Bytes 62-63: number of IN reports skipped by report-on-change
+            APP_DeviceJoystickGetStatus(&mapFeatureBuf[60]);
             
             // Send the data back to the host through endpoint 0
             USBEP0SendRAMPtr(mapFeatureBuf, HID_MAP_EP_BUF_SIZE, USB_EP0_INCLUDE_ZERO);
@@ -0,0 +1,40 @@
+#ifndef USB_PERSONALITY_H
+#define USB_PERSONALITY_H
+
+#include <stdint.h>
+
+/* ────────────────────────────────────────────────────────────────────────────
+   USB personality
+     1つのイメージにディスクリプタ一式 (デバイス / コンフィグ / レポート) と
+     レポート変換関数を複数持ち、起動時にどれを名乗るかを選ぶ。
+     USBPersonalities[] の添字が personality ID (HEF map の personality)。
+   ──────────────────────────────────────────────────────────────────────────── */
+#define PERSONALITY_GENERIC   0   // Generic HID gamepad (04D8:E888)
+#define PERSONALITY_SWITCH    1   // Switch compatible gamepad (0F0D:0092)
+#define PERSONALITY_COUNT     2
+
+typedef struct {
+    const uint8_t *device;          // Device descriptor
+    const uint8_t *const *config;   // Configuration descriptor table
+    const uint8_t *report;          // Interface 0 report descriptor
+    uint8_t reportSize;             // Size of the interface 0 report descriptor
+    uint8_t inputSize;              // Size of the EP1 IN report
+    uint16_t bootButton;            // BUTTON_SNAP_* held at plug-in to select this personality
+    void (*pack)(uint8_t *report);  // Converts the generic report in place (NULL = as is)
+} USB_PERSONALITY;
+
+/* Active personality (valid before USBDeviceInit()) */
+extern const USB_PERSONALITY *USBPersonality;
+
+/**
+ * Select the personality before USB enumeration
+ * A personality whose boot button is held overrides the stored one.
+ * @param stored Personality ID stored in the HEF map
+ * @param buttons BUTTON_Snapshot() taken at plug-in
+ */
+void USBPersonalitySelect(uint8_t stored, uint16_t buttons);
+
+/* Report packers (my_app_device_gamepad.c) */
+void App_DeviceGamepadPackSwitch(uint8_t *report);
+
+#endif // USB_PERSONALITY_H
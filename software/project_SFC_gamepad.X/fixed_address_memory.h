@@ -22,12 +22,17 @@ please contact mla_licensing@microchip.com
 
 #define FIXED_ADDRESS_MEMORY
 
+/* joystick_input follows the EP0 buffers, which grow with USB_EP0_BUFF_SIZE
+   (usb_config.h; checked in app_device_joystick.c) */
+#define JOYSTICK_DATA_ADDR  ((USB_EP0_BUFF_SIZE > 16) ? 0x20A0 : 0x2050)
+#define HID_CUSTOM_IN_DATA_BUFFER_ADDR  ((USB_EP0_BUFF_SIZE > 16) ? 0x20F0 : 0x20A0)
+
 #if(__XC8_VERSION < 2000)
-    #define JOYSTICK_DATA_ADDRESS @0x2050
-    #define HID_CUSTOM_IN_DATA_BUFFER_ADDRESS @0x20A0
+    #define JOYSTICK_DATA_ADDRESS @JOYSTICK_DATA_ADDR
+    #define HID_CUSTOM_IN_DATA_BUFFER_ADDRESS @HID_CUSTOM_IN_DATA_BUFFER_ADDR
 #else
-    #define JOYSTICK_DATA_ADDRESS __at(0x2050)
-    #define HID_CUSTOM_IN_DATA_BUFFER_ADDRESS __at(0x20A0)
+    #define JOYSTICK_DATA_ADDRESS __at(JOYSTICK_DATA_ADDR)
+    #define HID_CUSTOM_IN_DATA_BUFFER_ADDRESS __at(HID_CUSTOM_IN_DATA_BUFFER_ADDR)
 #endif
 
 #endif //FIXED_MEMORY_ADDRESS
\ No newline at end of file
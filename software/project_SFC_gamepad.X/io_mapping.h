@@ -28,3 +28,29 @@ limitations under the License.
 #define BUTTON_SELECT   PORTBbits.RB5
 #define BUTTON_RIGHT    PORTBbits.RB4
 #define BUTTON_TL       PORTCbits.RC2
+
+/* Packed button snapshot (see BUTTON_Snapshot()), 1 = pressed
+ *   bit 2-7   : RC2-RC7
+ *   bit 8-9   : RA4-RA5
+ *   bit 12-15 : RB4-RB7
+ */
+#define BUTTON_SNAP_TL      0x0004  // RC2
+#define BUTTON_SNAP_B       0x0008  // RC3
+#define BUTTON_SNAP_A       0x0010  // RC4
+#define BUTTON_SNAP_X       0x0020  // RC5
+#define BUTTON_SNAP_LEFT    0x0040  // RC6
+#define BUTTON_SNAP_DOWN    0x0080  // RC7
+#define BUTTON_SNAP_TR      0x0100  // RA4
+#define BUTTON_SNAP_Y       0x0200  // RA5
+#define BUTTON_SNAP_RIGHT   0x1000  // RB4
+#define BUTTON_SNAP_SELECT  0x2000  // RB5
+#define BUTTON_SNAP_START   0x4000  // RB6
+#define BUTTON_SNAP_UP      0x8000  // RB7
+#define BUTTON_SNAP_MASK    0xF3FC
+
+/* Buttons that wake the device from the USB suspend sleep (system.c).
+ * The PIC16F1459 has interrupt-on-change on PORTA and PORTB only: a press
+ * (falling edge) on those pins wakes it, a press on PORTC does not.
+ */
+#define BUTTON_IOC_A        0x30    // RA4-RA5
+#define BUTTON_IOC_B        0xF0    // RB4-RB7
@@ -0,0 +1,269 @@
+/*******************************************************************************
+Copyright 2025 Custom USB Gamepad Project
+
+Press-to-USB latency instrumentation
+*******************************************************************************/
+
+#include "latency.h"
+#include <xc.h>
+#include <string.h>
+
+/* ────────────────────────────────────────────────────────────────────────────
+   時刻は (SOF フレーム番号, SOF からの Timer0 tick) の組で記録する
+     Timer0 1tick = 256/12MHz = 21.3us なので tick 差は x64/3 で us になる。
+   入力エッジ (前回と異なるレポートを組み立てたときのサンプリング時刻)、
+   EP1 への arm、ホストの取り込み (UOWN クリア) の3点を記録し、
+   区間ごとの min / max / 平均とヒストグラムはメインループ (Latency_Update())
+   で更新する。取り込みは割り込み (EVENT_TRANSFER) からも記録されるので、
+   そこではタイムスタンプを取るだけにして、us への変換 (32bit の乗除算) を
+   割り込み側に持ち込まない (XC8 が算術ライブラリを割り込み用に複製する)。
+   平均も更新時に求めておき、フィーチャーレポートの読み出しはコピーだけにする。
+   EP1 IN に arm するレポートは常に1つなので、arm 中の記録も1つだけ持つ。
+   サスペンドからのボタン起床は SOF も Timer0 も止まっているので、
+   LFINTOSC (31kHz, 1tick = 32us) で数える Timer1 で、起床から
+   起床後最初に arm したレポートの取り込みまでを測る。
+   ──────────────────────────────────────────────────────────────────────────── */
+#define WAKE_T1CON      0xC5    // Timer1: LFINTOSC, 1:1, not synchronized, on
+#define WAKE_TICK_US    32
+
+enum {
+    WAKE_NONE = 0,
+    WAKE_WAIT_ARM,      // woken up, no report armed yet
+    WAKE_ARMED,         // first report armed
+    WAKE_PICKED         // first report picked up, Timer1 stopped
+};
+typedef struct {
+    uint16_t frame;     // SOF count
+    uint8_t phase;      // Timer0 ticks after that SOF
+} LATENCY_STAMP;
+
+typedef struct {
+    uint16_t min;       // us
+    uint16_t max;       // us
+    uint32_t sum;       // us
+    uint16_t avg;       // us, sum / edges
+} LATENCY_STAT;
+
+enum {
+    LAT_SAMPLE_ARM = 0, // edge sampled -> report armed
+    LAT_ARM_PICKUP,     // report armed -> picked up by the host
+    LAT_TOTAL,          // edge sampled -> picked up by the host
+    LAT_NUM
+};
+
+static volatile uint16_t sofFrame;
+static volatile uint8_t sofTmr0;
+
+static LATENCY_STAMP sampleStamp;       // sampling of the report being built
+static LATENCY_STAMP armStamp;          // arming of the report in flight
+static uint16_t inFlightSampleArm;      // sample -> arm of the report in flight
+static volatile bool inFlight;          // an edge report is armed, not picked up
+static LATENCY_STAMP pickupStamp;       // host pickup of the report in flight
+static volatile bool pickedUp;          // pickupStamp taken, statistics not updated
+
+static uint16_t edges;                  // edge reports picked up
+static LATENCY_STAT stat[LAT_NUM];
+static uint16_t hist[LATENCY_HIST_BINS]; // LAT_TOTAL histogram
+
+static volatile uint8_t wakeState;      // WAKE_*
+static uint16_t wakes;                  // wake-ups timed
+static uint32_t wakeLast;               // wake-up -> first report picked up, us
+static uint32_t wakeMax;
+
+/**
+ * Take a time stamp
+ * @param s Stamp to fill
+ */
+static void Latency_Now(LATENCY_STAMP* s) {
+    s->frame = sofFrame;
+    s->phase = (uint8_t)(TMR0 - sofTmr0);
+}
+
+/**
+ * Time between two stamps
+ * @param from Earlier stamp
+ * @param to Later stamp
+ * @return Microseconds, saturated to 0-65535
+ */
+static uint16_t Latency_Us(const LATENCY_STAMP* from, const LATENCY_STAMP* to) {
+    int32_t us = (int32_t)(uint16_t)(to->frame - from->frame) * 1000
+               + ((int16_t)to->phase - (int16_t)from->phase) * 64 / 3;
+
+    if (us < 0) return 0;
+    if (us > 0xFFFF) return 0xFFFF;
+    return (uint16_t)us;
+}
+
+/**
+ * Add a sample to a statistic
+ * @param st Statistic
+ * @param us Sample in us
+ */
+static void Latency_Add(LATENCY_STAT* st, uint16_t us) {
+    if (edges == 1 || us < st->min) st->min = us;
+    if (us > st->max) st->max = us;
+    st->sum += us;
+    st->avg = (uint16_t)(st->sum / edges);
+}
+
+/**
+ * Count the timed wake-up: the first report after it has been picked up
+ */
+static void Latency_WakeDone(void) {
+    uint32_t us;
+
+    wakeState = WAKE_NONE;
+    us = ((uint16_t)TMR1H << 8 | TMR1L) * (uint32_t)WAKE_TICK_US;
+    if (PIR1bits.TMR1IF) us = 0xFFFFFFFF;   // over 2s
+
+    if (wakes == 0xFFFF) return;
+    wakes++;
+    wakeLast = us;
+    if (us > wakeMax) wakeMax = us;
+}
+
+/**
+ * Time stamp the USB start of frame
+ */
+void Latency_SOF(void) {
+    sofTmr0 = TMR0;
+    sofFrame++;
+}
+
+/**
+ * Time stamp the button sampling of the report being built
+ */
+void Latency_Sample(void) {
+    Latency_Now(&sampleStamp);
+}
+
+/**
+ * Record that a report has been armed on EP1 IN
+ * @param edge true if the report carries an input edge
+ */
+void Latency_Armed(bool edge) {
+    LATENCY_STAMP now;
+
+    Latency_Now(&now);
+
+    // The endpoint is free again, so the previous report has been picked up
+    // even if the transfer event has not been delivered yet: close it out now.
+    if (inFlight) Latency_Pickup();
+    Latency_Update();
+
+    if (wakeState == WAKE_WAIT_ARM) {
+        // Timed from the wake-up instead: SOF and Timer0 stopped in the sleep
+        wakeState = WAKE_ARMED;
+    } else if (edge) {
+        armStamp = now;
+        inFlightSampleArm = Latency_Us(&sampleStamp, &now);
+        inFlight = true;
+    }
+}
+
+/**
+ * Record that the host has picked up the armed report
+ * Only takes the time stamp: this runs in the ISR in USB_INTERRUPT mode.
+ */
+void Latency_Pickup(void) {
+    if (wakeState == WAKE_ARMED) {
+        T1CONbits.TMR1ON = 0;       // stopped, TMR1H:TMR1L read as one value
+        wakeState = WAKE_PICKED;
+    }
+    if (!inFlight || pickedUp) return;
+    Latency_Now(&pickupStamp);
+    pickedUp = true;
+}
+
+/**
+ * Add the picked up report to the statistics
+ */
+void Latency_Update(void) {
+    uint16_t sampleArm = inFlightSampleArm;
+    uint16_t armPickup;
+    uint16_t total;
+    uint8_t bin;
+
+    if (wakeState == WAKE_PICKED) Latency_WakeDone();
+    if (!pickedUp) return;
+    pickedUp = false;
+    inFlight = false;
+
+    armPickup = Latency_Us(&armStamp, &pickupStamp);
+    total = (sampleArm > 0xFFFF - armPickup) ? 0xFFFF : sampleArm + armPickup;
+
+    if (edges == 0xFFFF) return;        // saturated, keep the averages valid
+    edges++;
+    Latency_Add(&stat[LAT_SAMPLE_ARM], sampleArm);
+    Latency_Add(&stat[LAT_ARM_PICKUP], armPickup);
+    Latency_Add(&stat[LAT_TOTAL], total);
+
+    bin = (uint8_t)(total / LATENCY_HIST_US);
+    if (bin >= LATENCY_HIST_BINS) bin = LATENCY_HIST_BINS - 1;
+    hist[bin]++;
+}
+
+/**
+ * Start timing a wake-up
+ */
+void Latency_Wake(void) {
+    T1CON = 0;
+    TMR1H = 0;
+    TMR1L = 0;
+    PIR1bits.TMR1IF = 0;
+    T1CON = WAKE_T1CON;
+    wakeState = WAKE_WAIT_ARM;
+}
+
+/**
+ * Clear the statistics
+ */
+void Latency_Reset(void) {
+    edges = 0;
+    wakes = 0;
+    wakeLast = 0;
+    wakeMax = 0;
+    inFlight = false;
+    pickedUp = false;
+    wakeState = WAKE_NONE;
+    memset(stat, 0, sizeof(stat));
+    memset(hist, 0, sizeof(hist));
+}
+
+/**
+ * Copy the statistics to the Feature Report buffer
+ * Byte 0: Report ID, Byte 1: version, Bytes 2-3: edge count,
+ * Bytes 4-21: min / max / avg in us of sample->arm, arm->pickup and
+ * sample->pickup, Bytes 22-39: sample->pickup histogram (250us buckets,
+ * the last one counts 2ms and over), Bytes 40-41: wake-ups timed,
+ * Bytes 42-45 / 46-49: last / max wake-up -> first report picked up in us.
+ * All values are little endian.
+ * @param featureReport The 64 byte feature report buffer to be sent to the host
+ */
+void Latency_GetAsFeatureReport(uint8_t* featureReport) {
+    uint8_t* p = featureReport + 4;
+
+    featureReport[0] = LATENCY_REPORT_ID;
+    featureReport[1] = LATENCY_RPT_VER;
+    featureReport[2] = (uint8_t)edges;
+    featureReport[3] = (uint8_t)(edges >> 8);
+
+    for (uint8_t i = 0; i < LAT_NUM; i++) {
+        uint16_t avg = stat[i].avg;
+
+        *p++ = (uint8_t)stat[i].min;
+        *p++ = (uint8_t)(stat[i].min >> 8);
+        *p++ = (uint8_t)stat[i].max;
+        *p++ = (uint8_t)(stat[i].max >> 8);
+        *p++ = (uint8_t)avg;
+        *p++ = (uint8_t)(avg >> 8);
+    }
+    for (uint8_t i = 0; i < LATENCY_HIST_BINS; i++) {
+        *p++ = (uint8_t)hist[i];
+        *p++ = (uint8_t)(hist[i] >> 8);
+    }
+    *p++ = (uint8_t)wakes;
+    *p++ = (uint8_t)(wakes >> 8);
+    for (uint8_t i = 0; i < 4; i++) *p++ = (uint8_t)(wakeLast >> (8 * i));
+    for (uint8_t i = 0; i < 4; i++) *p++ = (uint8_t)(wakeMax >> (8 * i));
+}
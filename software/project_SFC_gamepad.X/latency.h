@@ -0,0 +1,72 @@
+/*******************************************************************************
+Copyright 2025 Custom USB Gamepad Project
+
+Press-to-USB latency instrumentation
+*******************************************************************************/
+
+#ifndef _LATENCY_H
+#define _LATENCY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Feature report ID of the latency statistics on interface 1
+   (next to the mapping report, MAP_REPORT_ID) */
+#define LATENCY_REPORT_ID   0x02
+#define LATENCY_RPT_VER     0x02
+
+#define LATENCY_HIST_US     250     // histogram bucket width in us
+#define LATENCY_HIST_BINS   9       // 8 buckets up to 2ms + 1 bucket for 2ms and over
+
+/**
+ * Time stamp the USB start of frame
+ * Call this on every EVENT_SOF.
+ */
+void Latency_SOF(void);
+
+/**
+ * Time stamp the button sampling of the report being built
+ */
+void Latency_Sample(void);
+
+/**
+ * Record that a report has been armed on EP1 IN
+ * @param edge true if the report differs from the previous one built,
+ *             i.e. it carries an input edge sampled by Latency_Sample()
+ */
+void Latency_Armed(bool edge);
+
+/**
+ * Record that the host has picked up the armed report (BDT UOWN cleared)
+ * Call this on EVENT_TRANSFER of the joystick IN endpoint, or when the
+ * application finds the BDT free; the first call counts.  It only takes
+ * the time stamp, so it can run in the USB interrupt.
+ */
+void Latency_Pickup(void);
+
+/**
+ * Add the picked up report (and a timed wake-up) to the statistics
+ * Call this from the main loop, with the USB interrupt masked, after
+ * Latency_Pickup().  Latency_Armed() calls it as well.
+ */
+void Latency_Update(void);
+
+/**
+ * Start timing a wake-up: a button press has ended the suspend sleep
+ * The first report armed after it is timed from the wake-up to its host
+ * pickup (wake-to-first-report) and kept out of the edge statistics.
+ */
+void Latency_Wake(void);
+
+/**
+ * Clear the statistics
+ */
+void Latency_Reset(void);
+
+/**
+ * Copy the statistics to the Feature Report buffer
+ * @param featureReport The 64 byte feature report buffer to be sent to the host
+ */
+void Latency_GetAsFeatureReport(uint8_t* featureReport);
+
+#endif /* _LATENCY_H */
@@ -0,0 +1,210 @@
+/*******************************************************************************
+Copyright 2025 Custom USB Gamepad Project
+
+Macro recorder and frame-exact playback
+*******************************************************************************/
+
+#include "macro.h"
+#include "io_mapping.h"
+
+#define STOP_COMBO  (BUTTON_SNAP_SELECT | BUTTON_SNAP_TL)
+
+/* ────────────────────────────────────────────────────────────────────────────
+   記録
+     USB フレームごとに、そのフレームで最後にサンプルしたボタン状態を
+     1 フレーム分として数え、同じ状態が続く間は今のステップの frames を
+     伸ばすだけにする。状態が変わったときに次のステップを開く。
+     CPU が止まっていた間 (マッピングのフラッシュ書き込みなど) のフレームは、
+     前の状態が続いたものとして数える (経過フレーム数で frames を伸ばす)。
+     停止コンボ (Select + L) を押している末尾のステップは、停止時に
+     macroLength から外して切り捨てる。
+     macroLength は停止時に決めるので、記録中や記録を打ち切ったときは
+     再生されない。
+     マクロは RAM にだけ置く (電源を切ると消える)。フラッシュには書かないので
+     14bit ワードへの詰め込みや終端マーカーは持たない。
+   再生
+     再生開始フレームからの経過 USB フレーム数でマクロを進めるので、
+     メインループの周期やサンプル回数にかかわらず 1 フレームに 1 状態が
+     記録どおりの順で出る。
+   ──────────────────────────────────────────────────────────────────────────── */
+MACRO_STEP macroSteps[MACRO_STEPS];
+uint8_t macroLength;
+
+static uint8_t state = MACRO_IDLE;
+
+/* Recording */
+static uint8_t wrIndex;             // steps opened, the last one is the open run
+static bool released;               // all buttons released since Macro_Record()
+static bool overflow;               // a step did not fit, stop recording
+static uint16_t recFrame;           // frame of curSnap
+static uint16_t curSnap;            // last sample of recFrame
+static bool cutActive;              // the open run is part of the stop combo tail
+static uint8_t cutIndex;            // first step of the stop combo tail
+
+/* Playback */
+static uint8_t playIndex;           // next step to read
+static uint16_t playSnap;           // current macro state
+static uint16_t playLeft;           // frames left of the current step
+static uint16_t playFrame;          // last frame played
+
+/**
+ * Open the next step of the recording
+ * @param snap Button state
+ * @return false if the macro area is full
+ */
+static bool Macro_Open(uint16_t snap) {
+    if (wrIndex >= MACRO_STEPS) {
+        overflow = true;
+        return false;
+    }
+    macroSteps[wrIndex].snap = snap;
+    macroSteps[wrIndex].frames = 0;
+    wrIndex++;
+    return true;
+}
+
+/**
+ * Record frames of one state
+ * @param snap Button state
+ * @param n Number of frames (at least 1)
+ */
+static void Macro_RecFrames(uint16_t snap, uint16_t n) {
+    if (wrIndex == 0 || snap != macroSteps[wrIndex - 1].snap) {
+        if (snap & STOP_COMBO) {
+            if (!cutActive) cutIndex = wrIndex;
+            cutActive = true;
+        } else {
+            cutActive = false;
+        }
+        if (!Macro_Open(snap)) return;
+    }
+    // Runs longer than MACRO_FRAMES_MAX frames take several steps
+    while (n != 0) {
+        MACRO_STEP* step = &macroSteps[wrIndex - 1];
+        uint16_t room = MACRO_FRAMES_MAX - step->frames;
+
+        if (n <= room) {
+            step->frames += n;
+            break;
+        }
+        step->frames = MACRO_FRAMES_MAX;
+        n -= room;
+        if (!Macro_Open(snap)) return;
+    }
+}
+
+/**
+ * Read the next macro step for playback
+ * @return false at the end of the macro
+ */
+static bool Macro_Next(void) {
+    if (playIndex >= macroLength) return false;
+    playSnap = macroSteps[playIndex].snap;
+    playLeft = macroSteps[playIndex].frames;
+    playIndex++;
+    return true;
+}
+
+/**
+ * Start recording
+ */
+void Macro_Record(void) {
+    state = MACRO_ARMED;
+    released = false;
+    overflow = false;
+    macroLength = 0;                    // set when the recording stops
+    wrIndex = 0;
+    cutActive = false;
+}
+
+/**
+ * Start playback of the stored macro
+ * @param frame USB frame count of the current frame, the first macro frame
+ * @return false if no complete macro is stored (or one is being recorded)
+ */
+bool Macro_Play(uint16_t frame) {
+    if (state != MACRO_IDLE && state != MACRO_PLAYING) return false;
+    if (macroLength == 0) return false;
+
+    playIndex = 0;
+    Macro_Next();
+    playFrame = frame;
+    state = MACRO_PLAYING;
+    return true;
+}
+
+/**
+ * Stop recording or playback
+ */
+void Macro_Stop(void) {
+    switch (state) {
+        case MACRO_RECORDING:
+            macroLength = cutActive ? cutIndex : wrIndex;
+            break;
+
+        default:
+            // Playback, or a recording that never started (left without a macro)
+            break;
+    }
+    state = MACRO_IDLE;
+}
+
+/**
+ * Get the recorder / player state
+ * @return MACRO_*
+ */
+uint8_t Macro_GetState(void) {
+    return state;
+}
+
+/**
+ * Pass one button sample through the recorder / player
+ * @param snap BUTTON_Snapshot() bits
+ * @param frame USB frame count (advances on every SOF)
+ * @return snap, or the macro frame during playback
+ */
+uint16_t Macro_Sample(uint16_t snap, uint16_t frame) {
+    switch (state) {
+        case MACRO_ARMED:
+            // Start at the first press after the start combo is released
+            if (snap == 0) {
+                released = true;
+            } else if (released) {
+                state = MACRO_RECORDING;
+                recFrame = frame;
+                curSnap = snap;
+            }
+            break;
+
+        case MACRO_RECORDING:
+            if (frame != recFrame) {
+                Macro_RecFrames(curSnap, (uint16_t)(frame - recFrame));
+                recFrame = frame;
+                if (overflow) {
+                    Macro_Stop();       // the macro area is full
+                    break;
+                }
+            }
+            curSnap = snap;
+            break;
+
+        case MACRO_PLAYING: {
+            uint16_t elapsed = (uint16_t)(frame - playFrame);
+
+            playFrame = frame;
+            while (elapsed >= playLeft) {
+                elapsed -= playLeft;
+                if (!Macro_Next()) {
+                    state = MACRO_IDLE;
+                    return snap;
+                }
+            }
+            playLeft -= elapsed;
+            return playSnap;
+        }
+
+        default:
+            break;
+    }
+    return snap;
+}
@@ -0,0 +1,76 @@
+/*******************************************************************************
+Copyright 2025 Custom USB Gamepad Project
+
+Macro recorder and frame-exact playback
+*******************************************************************************/
+
+#ifndef _MACRO_H
+#define _MACRO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Macro area: a RAM buffer of steps.  The macro is lost on power-off: it
+   is never written to flash, so it has no flash word format.  Program
+   flash below the HEF is left to the application image. */
+#define MACRO_STEPS         16
+#define MACRO_FRAMES_MAX    0xFFFF      // longer runs of one state take several steps
+
+/* One state of the macro and how many USB frames it lasts */
+typedef struct {
+    uint16_t snap;          // BUTTON_Snapshot() bits
+    uint16_t frames;        // 1..MACRO_FRAMES_MAX
+} MACRO_STEP;
+
+/* Recorder / player state */
+enum {
+    MACRO_IDLE = 0,
+    MACRO_ARMED,            // recording starts at the first press
+    MACRO_RECORDING,
+    MACRO_PLAYING
+};
+
+/* Macro area: the stored macro is macroSteps[0..macroLength - 1].
+   macroLength is 0 while no complete macro is stored (also while recording). */
+extern MACRO_STEP macroSteps[MACRO_STEPS];
+extern uint8_t macroLength;
+
+/**
+ * Start recording
+ * The stored macro is dropped. Recording starts at the first sample with
+ * a button pressed after all buttons were released.
+ */
+void Macro_Record(void);
+
+/**
+ * Start playback of the stored macro
+ * @param frame USB frame count of the current frame, the first macro frame
+ * @return false if no complete macro is stored (or one is being recorded)
+ */
+bool Macro_Play(uint16_t frame);
+
+/**
+ * Stop recording or playback
+ * A recording is kept, without the trailing states that hold Select or L
+ * (the stop combo).
+ */
+void Macro_Stop(void);
+
+/**
+ * Get the recorder / player state
+ * @return MACRO_*
+ */
+uint8_t Macro_GetState(void);
+
+/**
+ * Pass one button sample through the recorder / player
+ * Call this for every report built. The sample is recorded once per USB
+ * frame (the last one of the frame); during playback the macro frame of
+ * the current USB frame replaces it.
+ * @param snap BUTTON_Snapshot() bits
+ * @param frame USB frame count (advances on every SOF)
+ * @return snap, or the macro frame during playback
+ */
+uint16_t Macro_Sample(uint16_t snap, uint16_t frame);
+
+#endif /* _MACRO_H */
@@ -21,6 +21,10 @@ please contact mla_licensing@microchip.com
  * 
  * Changes from the original source:
  *     - added device settings
+ *     - load mapping before the USB stack can raise events (USB_INTERRUPT)
+ *     - free-running timer0
+ *     - select the descriptor personality at plug-in
+ *     - remote wakeup on a button press during suspend
  ********************************************************************/
 
 /** INCLUDES *******************************************************/
@@ -31,6 +35,7 @@ please contact mla_licensing@microchip.com
 
 #include "app_device_joystick.h"
 #include "mapping.h"
+#include "usb_personality.h"
 
 
 
@@ -38,10 +43,10 @@ MAIN_RETURN main(void)
 {
     SYSTEM_Initialize(SYSTEM_STATE_USB_START);
 
-    USBDeviceInit();
-    USBDeviceAttach();
-    
-    // Load button-to-usage mapping from High-Endurance Flash
+    // Load button-to-usage mapping from High-Endurance Flash.
+    // This must be done before USBDeviceAttach(), since in USB_INTERRUPT mode
+    // the device can be configured (and start using the mapping) from the ISR
+    // at any time after attaching.
     Mapping_Load();
 
     /* set all ports input*/
@@ -59,6 +64,14 @@ MAIN_RETURN main(void)
     ANSELB = 0x00;
     ANSELC = 0x00;
     
+    // Pick the descriptor personality before the host can enumerate us.
+    // A personality's boot button held at plug-in overrides the stored one.
+    _delay(12000);      // let the pull-ups settle (1ms at 12 MIPS)
+    USBPersonalitySelect(Mapping_GetPersonality(), BUTTON_Snapshot());
+
+    USBDeviceInit();
+    USBDeviceAttach();
+
     /* initializing timer0 and interruption*/
     
     OPTION_REGbits.PS = 0b111;        // clock divided by 256
@@ -70,13 +83,13 @@ MAIN_RETURN main(void)
 //    INTCONbits.TMR0IE = 1;          // enabling peripheral interrupts
     INTCONbits.GIE = 1;             // enabling interrupts
     
-    // setting initial value of timer 0.
-    // 1 clock = 256/16MHz = 16us 
-    // the timer interrupt happens every 16us x 0xff(255) = 4080us .
-    // 
-    // set the timer0 value so that timer interruption happens every 4000us.
-    // 80us / 16us = 5 clocks
-    TMR0bits.TMR0 = (uint8_t)5;
+    // timer 0 is free-running.
+    // 1 clock = 256/(48MHz/4) = 21.3us
+    // the timer overflows every 21.3us x 256 = 5461us.
+    //
+    // the overflow flag is the tick of the mode-switch hold timer, and
+    // the counter itself time stamps SOF and report sampling.
+    TMR0bits.TMR0 = (uint8_t)0;
     
     
     while(1)
@@ -114,6 +127,14 @@ MAIN_RETURN main(void)
          * thus just continue back to the start of the while loop. */
         if( USBIsDeviceSuspended() == true )
         {
+            /* A button press ended the suspend sleep (system.c): signal
+             * resume to the host.  The report with the press goes out once
+             * the host has resumed the bus. */
+            if( SYSTEM_ButtonWake() == true )
+            {
+                USBCBSendResume();
+            }
+
             /* Jump back to the top of the while loop. */
             continue;
         }
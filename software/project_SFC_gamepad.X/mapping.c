@@ -6,36 +6,186 @@ Mapping functionality for button-to-usage configuration
 
 #include "mapping.h"
 #include <xc.h>
+#include <stdbool.h>
 #include <string.h>
 #include "mcc_generated_files/nvm/nvm.h"
 #include "demo_src/hid_rpt_map.h"
+#include "demo_src/usb_personality.h"
+#include "socd.h"
+#include "io_mapping.h"
+#include "buttons.h"
+
+/* One profile of the RAM working copy */
+typedef struct {
+    uint8_t name[PROFILE_NAME_LEN];   // Profile name (ASCII, 0 padded)
+    uint8_t tbl[NUM_BUTTONS];         // Button-to-usage mapping table
+    uint8_t turbo[NUM_BUTTONS];       // Turbo half period in USB frames, 0 = off
+    uint8_t socd;                     // SOCD policies, SOCD_POLICY(horizontal, vertical)
+    uint8_t crosskey;                 // Crosskey mode selected with the profile
+} MAP_PROFILE;
 
 /* RAM working copy of the mapping data */
 static struct {
-    // Bytes 0-7: Global settings (8 bytes)
-    uint8_t report_id;                // Report ID (Feature Report送信時に0x00設定)
-    uint8_t ver;                      // Version for compatibility checking
-    uint8_t crc;                      // CRC8 checksum for data integrity
-    uint8_t global_reserved[5];       // Reserved for future global settings
-    
-    // Bytes 8-23: Normal mode mapping (16 bytes)
-    uint8_t normal_tbl[NUM_BUTTONS];  // Normal mode button-to-usage mapping table (8 bytes)
-    uint8_t normal_reserved[8];       // Reserved for normal mode expansion (8 bytes)
-    
-    // Bytes 24-39: Special mode mapping (16 bytes)
-    uint8_t special_tbl[NUM_BUTTONS]; // Special mode button-to-usage mapping table (8 bytes)
-    uint8_t special_reserved[8];      // Reserved for special mode expansion (8 bytes)
-    
-    // Bytes 40-63: Future expansion (24 bytes)
-    uint8_t future_reserved[24];      // Reserved for future features
-} map;            
-
-#define MAP_VER 0x01           // Current data structure version
+    // Global settings
+    uint8_t debounce_ms;              // Button release debounce window in ms (0 = off)
+    uint8_t keepalive;                // Report-on-change keep-alive period in 4ms units (0 = send every frame)
+    uint8_t sof_phase;                // Report sampling phase after SOF in Timer0 ticks (0 = off)
+    uint8_t personality;              // USB personality used at plug-in (PERSONALITY_*)
+
+    MAP_PROFILE profile[MAP_PROFILES];
+} map;
+
+#define MAP_VER 0x02           // Feature report layout version (0x02: profiles)
 #define HEF_ADDR 0x1F80        // High-Endurance Flash starting address (row0)
+#define HEF_ROWS 4             // 0x1F80-0x1FFF (128 words)
 
-#define ROW_WORDS   32                  // 64B / 2B
+#define ROW_WORDS   32                  // 1 row = 32 words (下位バイトのみ使用)
 static flash_data_t rowBuf[ROW_WORDS];  // uint16_t[32]
 
+/* ────────────────────────────────────────────────────────────────────────────
+   HEF ログ
+     HEF の 4 行を循環ログとして使い、保存のたびに変更されたタグ
+     (mapping.h の MAP_TAG_*) だけを書き込み中の行の空きに追記する。
+       行       [seq][ver] の後にエントリが並び、残りは 0xFF (消去済み)
+       エントリ [tag][value][crc]  crc は seq, ver, tag, value の CRC8
+     行の消去は行が一杯になって次の行に移るときだけで、seq は移るたびに
+     1 増える。プロファイルは 15 バイト、全体設定は 6 バイトなので、
+     1 行 (30 バイト) にプロファイルの保存 2 回分が入る。
+     crc に行の seq / ver を含めるので、書き込み途中で電源が落ちた行や
+     エントリは読み込み時に弾かれ、その行にはそれ以上追記しない。
+     Mapping_Load() は古い行から順にエントリを読むので、同じタグは
+     新しいエントリが勝つ。ログに無いタグは既定値のまま。
+     行に移るとき、その次の行 (次に消す行) にしか最新のエントリが無い
+     タグを新しい行の先頭に書き写すので、消す行に最新のエントリが
+     残っていることはない (書き写すのは 1 行分以下なので必ず収まる)。
+     知らないタグは長さだけ見て飛ばし、知っているタグの値が長ければ
+     先頭だけ使うので、古いファームウェアも新しいエントリを読める。
+     エントリは 2 バイト以上あるので、解析は 1 行あたり最大 15 回の
+     ループで終わる。
+     ログの行が無いとき (消去済み、または以前のファームウェアのレコード)
+     はすべて既定値で始める。
+   ──────────────────────────────────────────────────────────────────────────── */
+#define REC_VER     0x06                // Log row format version (tag entries)
+#define ROW_HEADER  2                   // seq, ver
+#define ENTRY_BYTES (ROW_HEADER + 1 + 15)  // seq, ver, tag and the longest value
+#define NO_ROW      0xFF                // Tag not in the log (default value)
+
+/* Tags stored in the log: index 0 = MAP_TAG_GLOBAL, 1 + n = profile n */
+#define MAP_TAGS            (1 + MAP_PROFILES)
+#define TAG_BIT_GLOBAL      0x01
+#define TAG_BIT_PROFILE(n)  ((uint8_t)(0x02 << (n)))
+
+static uint8_t logRow;                  // Row the log appends to
+static uint8_t logSeq;                  // Sequence number of that row
+static uint8_t logPos;                  // Offset of the next entry in it (ROW_WORDS = full)
+static uint8_t tagRow[MAP_TAGS];        // Row holding the newest entry of each tag
+
+/* HEF への遅延書き込み (Mapping_Tasks() で1ステップずつ実行)
+   Mapping_Save() で変更されたタグを pendingTags に移し、1 回に 1 行の
+   書き込みか消去を行う */
+static uint8_t pendingTags;             // Tags to append (TAG_BIT_*)
+static uint8_t commitStatus = MAP_STATUS_COMMITTED;
+
+/* 使用中のプロファイル (RAM のみ、フラッシュには保存しない) */
+static uint8_t activeProfile;           // Profile compiled into compiled[]
+static uint8_t activeCrosskey;          // Crosskey mode in use
+static uint8_t windowProfile;           // Profile shown in the feature report
+static uint8_t tagSelect;               // Tag type read by the tag feature report
+
+/* 変更してまだ保存していないタグ (コマンドレポートの変更は MAP_CMD_COMMIT で保存) */
+static uint8_t changedTags;             // Tags changed in RAM since the last save (TAG_BIT_*)
+static uint8_t cmdOp;                   // Last command
+static uint8_t cmdResult;               // MAP_CMD_OK or MAP_CMD_REJECTED
+
+/* ────────────────────────────────────────────────────────────────────────────
+   defaultProfile[profile]:
+     ログにエントリが無いときのプロファイル
+     0: SFC 標準配置 (normal)、1: Switch 風配置 (special)、2-3: SFC 標準配置
+   ──────────────────────────────────────────────────────────────────────────── */
+static const MAP_PROFILE defaultProfile[MAP_PROFILES] = {
+    {   "NORM",
+        // A, B, X, Y, L1, R1, Select, Start
+        { 1, 2, 3, 4, 5, 6, 7, 8 },
+        { 0 }, SOCD_POLICY(SOCD_PRIORITY, SOCD_PRIORITY), 0
+    },
+    {   "SPCL",
+        // A, Home, Right Stick, Left Stick, L2, R2, Select, Start
+        { 1, 11, 12, 13, 9, 10, 7, 8 },
+        { 0 }, SOCD_POLICY(SOCD_PRIORITY, SOCD_PRIORITY), 0
+    },
+    {   "P3",
+        { 1, 2, 3, 4, 5, 6, 7, 8 },
+        { 0 }, SOCD_POLICY(SOCD_PRIORITY, SOCD_PRIORITY), 0
+    },
+    {   "P4",
+        { 1, 2, 3, 4, 5, 6, 7, 8 },
+        { 0 }, SOCD_POLICY(SOCD_PRIORITY, SOCD_PRIORITY), 0
+    }
+};
+
+/* ────────────────────────────────────────────────────────────────────────────
+   usageByte[usage]: 
+     usage (1–14) が INPUT_CONTROLS.val[] の何バイト目に対応するか
+   ──────────────────────────────────────────────────────────────────────────── */
+static const uint8_t usageByte[NUM_USAGES] = {
+    /*  0: 未使用 (無効) */  0,
+    /*  1: A            */  0,    // val[0].bit0
+    /*  2: B            */  0,    // val[0].bit1
+    /*  3: X            */  0,    // val[0].bit2
+    /*  4: Y            */  0,    // val[0].bit3
+    /*  5: L1           */  0,    // val[0].bit4
+    /*  6: R1           */  0,    // val[0].bit5
+    /*  7: Select       */  0,    // val[0].bit6
+    /*  8: Start        */  0,    // val[0].bit7
+    /*  9: L2           */  1,    // val[1].bit0
+    /* 10: R2           */  1,    // val[1].bit1
+    /* 11: Home         */  1,    // val[1].bit2
+    /* 12: Right Stick  */  1,    // val[1].bit3
+    /* 13: Left Stick   */  1,    // val[1].bit4
+    /* 14: Z (unused)   */  1     // val[1].bit5
+};
+
+/* ────────────────────────────────────────────────────────────────────────────
+   usageMask[usage]:
+     各 usage (1–14) がそのバイト内で何ビット目かを表すマスク
+   ──────────────────────────────────────────────────────────────────────────── */
+static const uint8_t usageMask[NUM_USAGES] = {
+    /*  0: 無効      */  0x00,
+    /*  1: A         */  1 << 0,  // val[0] bit0 → a
+    /*  2: B         */  1 << 1,  // val[0] bit1 → b
+    /*  3: X         */  1 << 2,  // val[0] bit2 → x
+    /*  4: Y         */  1 << 3,  // val[0] bit3 → y
+    /*  5: L1        */  1 << 4,  // val[0] bit4 → L1
+    /*  6: R1        */  1 << 5,  // val[0] bit5 → R1
+    /*  7: Select    */  1 << 6,  // val[0] bit6 → select
+    /*  8: Start     */  1 << 7,  // val[0] bit7 → start
+    /*  9: L2        */  1 << 0,  // val[1] bit0 → L2
+    /* 10: R2        */  1 << 1,  // val[1] bit1 → R2
+    /* 11: Home      */  1 << 2,  // val[1] bit2 → home
+    /* 12: RightStick*/  1 << 3,  // val[1] bit3 → right_stick
+    /* 13: LeftStick */  1 << 4,  // val[1] bit4 → left_stick
+    /* 14: Z (unused)*/  1 << 5   // val[1] bit5 → unused
+};
+
+/* ────────────────────────────────────────────────────────────────────────────
+   physSnap[phys]:
+     物理ボタン idx (PHYS_BTN_*) が BUTTON_Snapshot() の何ビット目か
+   ──────────────────────────────────────────────────────────────────────────── */
+static const uint16_t physSnap[NUM_BUTTONS] = {
+    /* PHYS_BTN_A      */  BUTTON_SNAP_A,
+    /* PHYS_BTN_B      */  BUTTON_SNAP_B,
+    /* PHYS_BTN_X      */  BUTTON_SNAP_X,
+    /* PHYS_BTN_Y      */  BUTTON_SNAP_Y,
+    /* PHYS_BTN_L      */  BUTTON_SNAP_TL,
+    /* PHYS_BTN_R      */  BUTTON_SNAP_TR,
+    /* PHYS_BTN_SELECT */  BUTTON_SNAP_SELECT,
+    /* PHYS_BTN_START  */  BUTTON_SNAP_START
+};
+
+/* 使用中のプロファイルのコンパイル済みマッピング */
+static MAP_ENTRY compiled[NUM_BUTTONS];
+static uint16_t turboMask;              // 連射設定のあるボタン (BUTTON_SNAP_* bits)
+
 /**
  * Calculate CRC8 checksum (0x07 polynomial)
  * @param d Pointer to data
@@ -53,109 +203,565 @@ static uint8_t crc8(const uint8_t *d, uint8_t l) {
     return c;
 }
 
-void map_to_rowbuf(void)
-{
-    /* 0x3FFF で初期化（未使用上位バイトは 0x3F） */
-    for (uint8_t i = 0; i < ROW_WORDS; i++) rowBuf[i] = 0x3FFF;
+/**
+ * Compile the active profile into the snapshot bit -> report bit table
+ * so that the report builder needs no range check or lookup per button,
+ * and set its SOCD policy
+ */
+static void Mapping_Compile(void) {
+    const MAP_PROFILE *p = &map.profile[activeProfile];
+
+    turboMask = 0;
+
+    for (uint8_t phys = 0; phys < NUM_BUTTONS; phys++) {
+        uint8_t usage = p->tbl[phys];
+        if (usage >= NUM_USAGES) usage = 0;     // 無効は mask 0 (何もしない)
+
+        compiled[phys].snap = physSnap[phys];
+        compiled[phys].idx  = usageByte[usage];
+        compiled[phys].mask = usageMask[usage];
+        compiled[phys].turbo = p->turbo[phys];
+        if (compiled[phys].turbo) turboMask |= physSnap[phys];
+    }
+    SOCD_SetPolicy(p->socd);
+}
+
+/**
+ * Apply the RAM mapping data to the input pipeline
+ */
+static void Mapping_Apply(void) {
+    Mapping_Compile();
+    BUTTON_SetDebounce(map.debounce_ms);
+}
+
+/**
+ * Get the flash address of a log row
+ * @param row HEF row (0 to HEF_ROWS-1)
+ * @return Flash word address
+ */
+static uint16_t Mapping_RowAddr(uint8_t row) {
+    return HEF_ADDR + (uint16_t)row * ROW_WORDS;
+}
+
+/**
+ * Read the low byte of a flash word
+ * @param addr Flash word address
+ * @return Stored byte (0xFF if erased)
+ */
+static uint8_t Mapping_ReadByte(uint16_t addr) {
+    // Read 14-bit words from flash and convert to 8-bit
+    return (uint8_t)(FLASH_Read(addr) & 0x00FF); // Use lower byte
+}
+
+/**
+ * Unpack a nibble packed table
+ * @param dst NUM_BUTTONS bytes
+ * @param src NUM_BUTTONS / 2 bytes, 2 values per byte (low nibble first)
+ */
+static void Mapping_Unpack(uint8_t *dst, const uint8_t *src) {
+    for (uint8_t i = 0; i < NUM_BUTTONS / 2; i++) {
+        dst[2 * i]     = src[i] & 0x0F;
+        dst[2 * i + 1] = src[i] >> 4;
+    }
+}
+
+/**
+ * Pack a table into nibbles
+ * @param dst NUM_BUTTONS / 2 bytes, 2 values per byte (low nibble first)
+ * @param src NUM_BUTTONS bytes (0-15)
+ */
+static void Mapping_Pack(uint8_t *dst, const uint8_t *src) {
+    for (uint8_t i = 0; i < NUM_BUTTONS / 2; i++) {
+        dst[i] = (uint8_t)(src[2 * i] | (src[2 * i + 1] << 4));
+    }
+}
+
+/**
+ * Check a profile before it goes into the RAM map
+ * @param p Profile
+ * @return true if every field is in range
+ */
+static bool Mapping_ProfileIsValid(const MAP_PROFILE *p) {
+    for (uint8_t i = 0; i < NUM_BUTTONS; i++) {
+        if (p->tbl[i] >= NUM_USAGES || p->turbo[i] > MAP_TURBO_MAX) return false;
+    }
+    return SOCD_HORIZONTAL(p->socd) < SOCD_POLICY_COUNT
+        && SOCD_VERTICAL(p->socd) < SOCD_POLICY_COUNT
+        && p->crosskey < CROSSKEY_MODES;
+}
 
-    /* uint8_t map 構造体をuint16_t rowBufにコピー */
-    for (uint8_t b = 0; b < sizeof(map); b++) {
-        rowBuf[b] = 0x3F00 | ((uint8_t*) &map)[b]; 
+/**
+ * Store a profile in the RAM map and mark it changed if it differs
+ * A new crosskey mode of the active profile takes effect at once; the
+ * caller recompiles the active profile.
+ * @param n Profile index (0 to MAP_PROFILES-1)
+ * @param p Valid profile
+ */
+static void Mapping_StoreProfile(uint8_t n, const MAP_PROFILE *p) {
+    if (memcmp(&map.profile[n], p, sizeof(*p)) == 0) return;
+
+    if (n == activeProfile && p->crosskey != map.profile[n].crosskey) {
+        activeCrosskey = p->crosskey;
+    }
+    map.profile[n] = *p;
+    changedTags |= TAG_BIT_PROFILE(n);
+}
+
+/**
+ * Store the global settings in the RAM map and mark them changed if they differ
+ * @param value debounce_ms, keepalive, sof_phase (clamped to SOF_PHASE_MAX),
+ *              valid personality
+ */
+static void Mapping_StoreGlobal(const uint8_t *value) {
+    uint8_t sofPhase = (value[2] > SOF_PHASE_MAX) ? SOF_PHASE_MAX : value[2];
+
+    if (map.debounce_ms != value[0] || map.keepalive != value[1]
+        || map.sof_phase != sofPhase || map.personality != value[3]) {
+        changedTags |= TAG_BIT_GLOBAL;
     }
+    map.debounce_ms = value[0];
+    map.keepalive = value[1];
+    map.sof_phase = sofPhase;
+    map.personality = value[3];
 }
 
 /**
- * Load mapping from High-Endurance Flash to RAM
- * If invalid data detected, initialize with default mapping
+ * Copy a tag value to the RAM map
+ * @param tag MAP_TAG(type, length)
+ * @param value Tag value (length bytes, longer values than known are cut)
+ * @return false for an unknown tag, a short value or a value out of range
+ *         (the RAM map is not changed)
+ */
+static bool Mapping_SetTagValue(uint8_t tag, const uint8_t *value) {
+    uint8_t type = MAP_TAG_TYPE(tag);
+    uint8_t len = MAP_TAG_LEN(tag);
+
+    if (type == MAP_TAG_GLOBAL) {
+        if (len < MAP_TAG_GLOBAL_LEN || value[3] >= PERSONALITY_COUNT) return false;
+
+        Mapping_StoreGlobal(value);
+        return true;
+    }
+    if (type >= MAP_TAG_PROFILE && type < MAP_TAG_PROFILE + MAP_PROFILES) {
+        MAP_PROFILE p;
+
+        if (len < MAP_TAG_PROFILE_LEN) return false;
+        memcpy(p.name, value, PROFILE_NAME_LEN);
+        Mapping_Unpack(p.tbl, &value[4]);
+        Mapping_Unpack(p.turbo, &value[8]);
+        p.socd = SOCD_POLICY(value[12] & 0x03, (value[12] >> 2) & 0x03);
+        p.crosskey = (value[12] >> 4) & 0x03;
+        if (!Mapping_ProfileIsValid(&p)) return false;
+
+        Mapping_StoreProfile(type - MAP_TAG_PROFILE, &p);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Copy a tag value from the RAM map
+ * @param type Tag type (MAP_TAG_*)
+ * @param value Buffer of at least 15 bytes
+ * @return MAP_TAG(type, length), length 0 for an unknown type
+ */
+static uint8_t Mapping_GetTagValue(uint8_t type, uint8_t *value) {
+    if (type == MAP_TAG_GLOBAL) {
+        value[0] = map.debounce_ms;
+        value[1] = map.keepalive;
+        value[2] = map.sof_phase;
+        value[3] = map.personality;
+        return MAP_TAG(type, MAP_TAG_GLOBAL_LEN);
+    }
+    if (type >= MAP_TAG_PROFILE && type < MAP_TAG_PROFILE + MAP_PROFILES) {
+        const MAP_PROFILE *p = &map.profile[type - MAP_TAG_PROFILE];
+
+        memcpy(value, p->name, PROFILE_NAME_LEN);
+        Mapping_Pack(&value[4], p->tbl);
+        Mapping_Pack(&value[8], p->turbo);
+        // SOCD policies (2 bits each) and the crosskey mode in one byte
+        value[12] = (uint8_t)(SOCD_HORIZONTAL(p->socd) | (SOCD_VERTICAL(p->socd) << 2) | (p->crosskey << 4));
+        return MAP_TAG(type, MAP_TAG_PROFILE_LEN);
+    }
+    return MAP_TAG(type & 0x0F, 0);
+}
+
+/**
+ * Get the tag type of a log tag index
+ * @param i Tag index (0 to MAP_TAGS-1)
+ * @return MAP_TAG_GLOBAL or a profile
+ */
+static uint8_t Mapping_TagType(uint8_t i) {
+    return i ? (uint8_t)(MAP_TAG_PROFILE + i - 1) : MAP_TAG_GLOBAL;
+}
+
+/**
+ * Get the log tag index of a tag type
+ * @param type Tag type (MAP_TAG_*)
+ * @return Tag index, MAP_TAGS for a type the log does not hold
+ */
+static uint8_t Mapping_TagIndex(uint8_t type) {
+    if (type == MAP_TAG_GLOBAL) return 0;
+    if (type >= MAP_TAG_PROFILE && type < MAP_TAG_PROFILE + MAP_PROFILES) return (uint8_t)(1 + type - MAP_TAG_PROFILE);
+    return MAP_TAGS;
+}
+
+/**
+ * Get the tags whose newest entry is in a log row
+ * @param row HEF row (0 to HEF_ROWS-1)
+ * @return TAG_BIT_* of the tags
+ */
+static uint8_t Mapping_RowTags(uint8_t row) {
+    uint8_t tags = 0;
+
+    for (uint8_t i = 0; i < MAP_TAGS; i++) {
+        if (tagRow[i] == row) tags |= (uint8_t)(1 << i);
+    }
+    return tags;
+}
+
+/**
+ * Read one entry of a log row and check its CRC
+ * The CRC covers the row header, so an entry is valid only in the row
+ * (and with the sequence number) it was written with.
+ * @param row HEF row (0 to HEF_ROWS-1)
+ * @param pos Offset of the entry in the row
+ * @param entry Buffer of ENTRY_BYTES: seq, ver, tag, value
+ * @return Size of the entry in the row, 0 at the end of the entries
+ *         (erased flash), ROW_WORDS for an entry cut short by a power loss
+ */
+static uint8_t Mapping_ReadEntry(uint8_t row, uint8_t pos, uint8_t *entry) {
+    uint16_t addr = Mapping_RowAddr(row);
+    uint8_t len;
+
+    entry[0] = Mapping_ReadByte(addr);
+    entry[1] = Mapping_ReadByte(addr + 1);
+    entry[2] = Mapping_ReadByte(addr + pos);
+    if (entry[2] == MAP_TAG_END) return 0;
+
+    len = MAP_TAG_LEN(entry[2]);
+    if (pos + 1 + len + 1 > ROW_WORDS) return ROW_WORDS;
+    for (uint8_t i = 0; i < len; i++) {
+        entry[ROW_HEADER + 1 + i] = Mapping_ReadByte(addr + pos + 1 + i);
+    }
+    if (Mapping_ReadByte(addr + pos + 1 + len) != crc8(entry, ROW_HEADER + 1 + len)) return ROW_WORDS;
+    return (uint8_t)(1 + len + 1);
+}
+
+/**
+ * Check that a HEF row is a log row: REC_VER and a valid first entry
+ * @param row HEF row (0 to HEF_ROWS-1)
+ * @return true if the row belongs to the log
+ */
+static bool Mapping_RowIsValid(uint8_t row) {
+    uint8_t entry[ENTRY_BYTES];
+    uint8_t n;
+
+    if (Mapping_ReadByte(Mapping_RowAddr(row) + 1) != REC_VER) return false;
+    n = Mapping_ReadEntry(row, ROW_HEADER, entry);
+    return n != 0 && n != ROW_WORDS;
+}
+
+/**
+ * Copy the entries of a log row to the RAM map
+ * Unknown and invalid tags are skipped.
+ * @param row Valid log row
+ * @return Offset after the last entry, ROW_WORDS if no entry can be
+ *         appended to the row
+ */
+static uint8_t Mapping_ParseRow(uint8_t row) {
+    uint8_t entry[ENTRY_BYTES];
+    uint8_t pos = ROW_HEADER;
+
+    while (pos < ROW_WORDS) {
+        uint8_t n = Mapping_ReadEntry(row, pos, entry);
+        uint8_t i;
+
+        if (n == 0) break;
+        if (n == ROW_WORDS) return ROW_WORDS;
+
+        i = Mapping_TagIndex(MAP_TAG_TYPE(entry[ROW_HEADER]));
+        if (Mapping_SetTagValue(entry[ROW_HEADER], &entry[ROW_HEADER + 1]) && i < MAP_TAGS) {
+            tagRow[i] = row;
+        }
+        pos += n;
+    }
+    // A cut write may have programmed words after the last entry
+    for (uint8_t i = pos; i < ROW_WORDS; i++) {
+        if (FLASH_Read(Mapping_RowAddr(row) + i) != 0x3FFF) return ROW_WORDS;
+    }
+    return pos;
+}
+
+/**
+ * Read the HEF log into the RAM map and find where it continues
+ * The RAM map must hold the defaults (the log holds only changed tags).
+ * @return true if the HEF holds a log
+ */
+static bool Mapping_ReadLog(void) {
+    bool found = false;
+
+    for (uint8_t row = 0; row < HEF_ROWS; row++) {
+        uint8_t seq = Mapping_ReadByte(Mapping_RowAddr(row));
+
+        if (!Mapping_RowIsValid(row)) continue;
+        // seq は周回するので差分の符号で新旧を判定する
+        if (!found || (int8_t)(seq - logSeq) > 0) {
+            found = true;
+            logSeq = seq;
+            logRow = row;
+        }
+    }
+    if (!found) return false;
+
+    // Oldest row first, so that the newest entry of a tag wins
+    for (uint8_t age = HEF_ROWS; age-- > 0; ) {
+        uint8_t row = (uint8_t)((logRow + HEF_ROWS - age) % HEF_ROWS);
+
+        if (!Mapping_RowIsValid(row) || Mapping_ReadByte(Mapping_RowAddr(row)) != (uint8_t)(logSeq - age)) continue;
+        logPos = Mapping_ParseRow(row);
+    }
+    return true;
+}
+
+/**
+ * Load mapping from the High-Endurance Flash log to RAM
+ * Tags not in the log keep their default value.
  */
 void Mapping_Load(void) {
-    // Read mapping data from flash to RAM via FLASH_Read
-    for(uint8_t i = 0; i < sizeof(map); i ++){
-        // Read 14-bit words from flash and convert to 8-bit
-        flash_data_t data = FLASH_Read(HEF_ADDR + i);
-        ((uint8_t*)&map)[i] = (uint8_t)(data & 0x00FF); // Use lower byte
-    }
-    
-    // Validate data (version and CRC)
-    if (map.ver != MAP_VER || map.crc != crc8((uint8_t*)&map, sizeof(map) - 1)) {
-        // Invalid data, initialize with standardized default mapping
-        
-        // Normal mode mapping - SFC standard layout
-        map.normal_tbl[PHYS_BTN_A] = 1;      // A -> Button 1 (A)
-        map.normal_tbl[PHYS_BTN_B] = 2;      // B -> Button 2 (B)
-        map.normal_tbl[PHYS_BTN_X] = 3;      // X -> Button 3 (X)
-        map.normal_tbl[PHYS_BTN_Y] = 4;      // Y -> Button 4 (Y)
-        map.normal_tbl[PHYS_BTN_L] = 5;      // L -> Button 5 (L1)
-        map.normal_tbl[PHYS_BTN_R] = 6;      // R -> Button 6 (R1)
-        map.normal_tbl[PHYS_BTN_SELECT] = 7; // Select -> Button 7 (Select)
-        map.normal_tbl[PHYS_BTN_START] = 8;  // Start -> Button 8 (Start)
-        
-        // Special mode mapping - Switch-like layout
-        map.special_tbl[PHYS_BTN_A] = 1;      // A -> Button 1 (A)
-        map.special_tbl[PHYS_BTN_B] = 11;     // B -> Button 11 (Home)
-        map.special_tbl[PHYS_BTN_X] = 12;     // X -> Button 12 (Right Stick)
-        map.special_tbl[PHYS_BTN_Y] = 13;     // Y -> Button 13 (Left Stick)
-        map.special_tbl[PHYS_BTN_L] = 9;      // L -> Button 9 (L2)
-        map.special_tbl[PHYS_BTN_R] = 10;     // R -> Button 10 (R2)
-        map.special_tbl[PHYS_BTN_SELECT] = 7; // Select -> Button 7 (Select)
-        map.special_tbl[PHYS_BTN_START] = 8;  // Start -> Button 8 (Start)
-        
-        // Clear all reserved areas
-        map.report_id = 0x00;  // Initialize report ID
-        memset(map.global_reserved, 0, sizeof(map.global_reserved));
-        memset(map.normal_reserved, 0, sizeof(map.normal_reserved));
-        memset(map.special_reserved, 0, sizeof(map.special_reserved));
-        memset(map.future_reserved, 0, sizeof(map.future_reserved));
-
-        map.ver = MAP_VER;  // Set version
-        map.crc = crc8((uint8_t*)&map, sizeof(map) - 1); // Calculate CRC
-    }
-}
-
-/**
- * Save mapping from RAM to High-Endurance Flash
- * @param normal_tbl Pointer to normal mode button-to-usage mapping table
- * @param special_tbl Pointer to special mode button-to-usage mapping table
- */
-void Mapping_Save(const uint8_t *normal_tbl, const uint8_t *special_tbl) {
-    // Copy new mapping tables to RAM structure
-    memcpy(map.normal_tbl, normal_tbl, NUM_BUTTONS);
-    memcpy(map.special_tbl, special_tbl, NUM_BUTTONS);
-    
-    // Update version and CRC, ensure report ID is set
-    map.report_id = 0x00;  // Set report ID
-    map.ver = MAP_VER;
-    map.crc = crc8((uint8_t*)&map, sizeof(map) - 1);
-    
-    // Convert map structure to row buffer for flash write
-    map_to_rowbuf();
-
-    // Save to flash via FLASH_RowWrite
-    uint8_t gie = INTCONbits.GIE;
-    INTCONbits.GIE = 0;
+    // Standardized defaults, overwritten by the entries of the log
+    memcpy(map.profile, defaultProfile, sizeof(map.profile));
+    map.debounce_ms = BUTTON_DEBOUNCE_DEFAULT_MS;
+    map.keepalive = 0;
+    map.sof_phase = 0;
+    map.personality = PERSONALITY_GENERIC;
+    memset(tagRow, NO_ROW, sizeof(tagRow));
+    activeProfile = 0;
+    pendingTags = 0;
+
+    if (!Mapping_ReadLog()) {
+        // No log: defaults, and the first entry starts the log at row 0 with seq 0
+        logRow = HEF_ROWS - 1;
+        logSeq = 0xFF;
+        logPos = ROW_WORDS;
+    }
+    changedTags = 0;
+    commitStatus = MAP_STATUS_COMMITTED;
+
+    // Power-up starts with profile 0
+    windowProfile = 0;
+    tagSelect = MAP_TAG_GLOBAL;
+    activeCrosskey = map.profile[0].crosskey;
+    Mapping_Apply();
+}
+
+/**
+ * Schedule the High-Endurance Flash write of the changed tags
+ * The flash is written later by Mapping_Tasks(), so this is safe to call
+ * from the EP0 completion path.
+ */
+void Mapping_Save(void) {
+    pendingTags |= changedTags;
+    changedTags = 0;
+    commitStatus = pendingTags ? MAP_STATUS_PENDING : MAP_STATUS_COMMITTED;
+}
+
+/**
+ * Build the row buffer image of the pending tags that fit in the log row
+ * The tags whose newest entry is in the row erased next come first. The
+ * other words stay 0x3FFF, so the entries already in the row are left as
+ * they are when it is programmed.
+ * @param end Offset after the last entry put in the image
+ * @return TAG_BIT_* of the tags put in the image, 0 if none fits
+ */
+static uint8_t Mapping_FillRow(uint8_t *end) {
+    uint8_t entry[ENTRY_BYTES];
+    uint8_t carry = Mapping_RowTags((uint8_t)((logRow + 1) % HEF_ROWS));
+    uint8_t pos = logPos;
+    uint8_t done = 0;
+
+    for (uint8_t i = 0; i < ROW_WORDS; i++) rowBuf[i] = 0x3FFF;
+    entry[0] = logSeq;
+    entry[1] = REC_VER;
+    if (pos == 0) {
+        rowBuf[0] = 0x3F00 | logSeq;
+        rowBuf[1] = 0x3F00 | REC_VER;
+        pos = ROW_HEADER;
+    }
+
+    for (uint8_t pass = 0; pass < 2; pass++) {
+        for (uint8_t i = 0; i < MAP_TAGS; i++) {
+            uint8_t bit = (uint8_t)(1 << i);
+            uint8_t len;
+
+            if (!(pendingTags & bit) || (done & bit) || (pass == 0 && !(carry & bit))) continue;
+
+            entry[ROW_HEADER] = Mapping_GetTagValue(Mapping_TagType(i), &entry[ROW_HEADER + 1]);
+            len = MAP_TAG_LEN(entry[ROW_HEADER]);
+            if (pos + 1 + len + 1 > ROW_WORDS) continue;
+
+            for (uint8_t b = 0; b <= len; b++) rowBuf[pos++] = 0x3F00 | entry[ROW_HEADER + b];
+            rowBuf[pos++] = 0x3F00 | crc8(entry, ROW_HEADER + 1 + len);
+            done |= bit;
+        }
+    }
+    *end = pos;
+    return done;
+}
+
+/**
+ * Run one step of a pending High-Endurance Flash commit
+ * Each call performs at most one erase or one row write (about 2ms each,
+ * the CPU stalls while the flash is busy), so call it at a point where a
+ * report has just been armed. A save takes one row write, and one erase
+ * more when the log moves on to the next row.
+ */
+void Mapping_Tasks(void) {
+    nvm_status_t result;
+    uint8_t next = (uint8_t)((logRow + 1) % HEF_ROWS);
+    uint8_t written;
+    uint8_t end;
+
+    if (pendingTags == 0) return;
+
+    written = Mapping_FillRow(&end);
     NVM_UnlockKeySet(UNLOCK_KEY);
-    FLASH_PageErase(HEF_ADDR);  // Erase the page before writing
-    while(NVM_IsBusy());  // Wait for erase to complete
-    FLASH_RowWrite(HEF_ADDR, rowBuf);    // Write the row buffer to flash
-    while(NVM_IsBusy());     
+    if (written != 0) {
+        result = FLASH_RowWrite(Mapping_RowAddr(logRow), rowBuf);
+    } else {
+        // The row is full: the log moves on and erases the next row
+        result = FLASH_PageErase(Mapping_RowAddr(next));
+    }
+    while(NVM_IsBusy());
     NVM_UnlockKeyClear();
-    INTCONbits.GIE = gie;
+
+    if (result != NVM_OK) {
+        // Nothing more is appended to the row; the tags wait for the next save
+        NVM_StatusClear();
+        logPos = ROW_WORDS;
+        changedTags |= pendingTags;
+        pendingTags = 0;
+        commitStatus = MAP_STATUS_FAILED;
+        return;
+    }
+
+    if (written != 0) {
+        logPos = end;
+        pendingTags &= (uint8_t)~written;
+        for (uint8_t i = 0; i < MAP_TAGS; i++) {
+            if (written & (1 << i)) tagRow[i] = logRow;
+        }
+        if (pendingTags == 0) commitStatus = MAP_STATUS_COMMITTED;
+        return;
+    }
+
+    // The erased row and the row erased next hand their newest entries
+    // over to the new row (only the row erased next, unless a save was cut)
+    pendingTags |= Mapping_RowTags(next) | Mapping_RowTags((uint8_t)((next + 1) % HEF_ROWS));
+    for (uint8_t i = 0; i < MAP_TAGS; i++) {
+        if (tagRow[i] == next) tagRow[i] = NO_ROW;
+    }
+    logRow = next;
+    logSeq++;
+    logPos = 0;
+}
+
+/**
+ * Get the commit status, with changes not saved yet
+ * @return MAP_STATUS_*
+ */
+static uint8_t Mapping_GetStatus(void) {
+    return (changedTags && commitStatus != MAP_STATUS_FAILED) ? MAP_STATUS_UNSAVED : commitStatus;
 }
 
 /**
  * Get the usage value for a physical button
  * @param physBtn Physical button index (0-7)
- * @param mode Mode selection (0=normal, 1=special)
+ * @param profile Profile index (0 to MAP_PROFILES-1)
  * @return Usage value
  */
-uint8_t Mapping_GetUsage(uint8_t physBtn, uint8_t mode) {
-    if (physBtn >= NUM_BUTTONS) return 0; // Invalid button index
-    
-    if (mode == 0) {
-        return map.normal_tbl[physBtn];
-    } else {
-        return map.special_tbl[physBtn];
-    }
+uint8_t Mapping_GetUsage(uint8_t physBtn, uint8_t profile) {
+    if (physBtn >= NUM_BUTTONS || profile >= MAP_PROFILES) return 0; // Invalid index
+
+    return map.profile[profile].tbl[physBtn];
+}
+
+/**
+ * Make a profile the active one
+ * Only RAM is touched: the profile is compiled in place (one pass over
+ * the NUM_BUTTONS buttons), so the next report already uses it.
+ * @param profile Profile index (0 to MAP_PROFILES-1)
+ */
+void Mapping_SelectProfile(uint8_t profile) {
+    if (profile >= MAP_PROFILES) return;
+
+    activeProfile = profile;
+    activeCrosskey = map.profile[profile].crosskey;
+    Mapping_Compile();
+}
+
+/**
+ * Get the active profile
+ * @return Profile index (0 to MAP_PROFILES-1)
+ */
+uint8_t Mapping_GetProfile(void) {
+    return activeProfile;
+}
+
+/**
+ * Get the compiled mapping table of the active profile
+ * @return Table of NUM_BUTTONS entries
+ */
+const MAP_ENTRY* Mapping_GetCompiled(void) {
+    return compiled;
+}
+
+/**
+ * Get the buttons with turbo in the active profile
+ * @return BUTTON_SNAP_* bits of the buttons whose compiled entry has turbo
+ */
+uint16_t Mapping_GetTurboMask(void) {
+    return turboMask;
+}
+
+/**
+ * Get the crosskey mode in use
+ * @return Crosskey mode (0 to CROSSKEY_MODES-1)
+ */
+uint8_t Mapping_GetCrosskey(void) {
+    return activeCrosskey;
+}
+
+/**
+ * Change the crosskey mode in use until the next profile switch
+ * @param mode Crosskey mode (0 to CROSSKEY_MODES-1)
+ */
+void Mapping_SetCrosskey(uint8_t mode) {
+    if (mode < CROSSKEY_MODES) activeCrosskey = mode;
+}
+
+/**
+ * Get the report-on-change keep-alive period
+ * @return Period in 4ms units (0 = report-on-change disabled)
+ */
+uint8_t Mapping_GetKeepAlive(void) {
+    return map.keepalive;
+}
+
+/**
+ * Get the SOF synchronized sampling phase
+ * @return Phase after SOF in Timer0 ticks (0 = sample as soon as possible)
+ */
+uint8_t Mapping_GetSOFPhase(void) {
+    return map.sof_phase;
+}
+
+/**
+ * Get the stored USB personality
+ * @return Personality ID (PERSONALITY_*) selected when no boot button is held
+ */
+uint8_t Mapping_GetPersonality(void) {
+    return map.personality;
 }
 
 /**
@@ -164,29 +770,67 @@ uint8_t Mapping_GetUsage(uint8_t physBtn, uint8_t mode) {
  * @param length Length of the feature report data
  */
 void Mapping_SetFromFeatureReport(uint8_t* featureReport, uint16_t length) {
-    // Feature report structure: [Report ID + 63 bytes data] = 64 bytes total
-    // Byte 0: Report ID, Byte 1: version, Byte 2: crc, Bytes 8-15: normal, Bytes 24-31: special
-    
+    // Feature report structure: [Report ID + 63 bytes data] = 64 bytes total, see mapping.h
+    const uint8_t *src = &featureReport[MAP_RPT_PROFILE_OFFSET];
+    MAP_PROFILE newProfile;
+    uint8_t window;
+    uint8_t active;
+    uint8_t sofPhase;
+    bool changed;
+
     // Ensure we have enough data for complete structure
     if (length < 64) {
         return; // Not enough data
     }
-    
-    uint8_t newNormalMapping[NUM_BUTTONS];
-    uint8_t newSpecialMapping[NUM_BUTTONS];
-    
-    // Copy normal mode mapping (bytes 8-15 in feature report)
-    for (uint8_t i = 0; i < NUM_BUTTONS; i++) {
-        newNormalMapping[i] = featureReport[8 + i];
+
+    window = featureReport[MAP_RPT_WINDOW_OFFSET];
+    active = featureReport[MAP_RPT_ACTIVE_OFFSET];
+    if (window >= MAP_PROFILES || active >= MAP_PROFILES) {
+        commitStatus = MAP_STATUS_FAILED;
+        return;
     }
-    
-    // Copy special mode mapping (bytes 24-31 in feature report)
-    for (uint8_t i = 0; i < NUM_BUTTONS; i++) {
-        newSpecialMapping[i] = featureReport[24 + i];
+
+    // Moving the window only selects the profile of the next GET_REPORT
+    if (window != windowProfile) {
+        windowProfile = window;
+        if (active != activeProfile) Mapping_SelectProfile(active);
+        return;
     }
-    
-    // Save both mapping tables to flash
-    Mapping_Save(newNormalMapping, newSpecialMapping);
+
+    // Bytes 7-28: socd, table, turbo, crosskey, name of the window profile
+    newProfile.socd = *src++;
+    memcpy(newProfile.tbl, src, NUM_BUTTONS);
+    src += NUM_BUTTONS;
+    memcpy(newProfile.turbo, src, NUM_BUTTONS);
+    src += NUM_BUTTONS;
+    newProfile.crosskey = *src++;
+    memcpy(newProfile.name, src, PROFILE_NAME_LEN);
+
+    // Validate before touching the working copy
+    if (featureReport[6] >= PERSONALITY_COUNT || !Mapping_ProfileIsValid(&newProfile)) {
+        commitStatus = MAP_STATUS_FAILED;
+        return;
+    }
+
+    // Global settings (bytes 3-6), the personality takes effect at the next plug-in
+    sofPhase = featureReport[5];
+    if (sofPhase > SOF_PHASE_MAX) sofPhase = SOF_PHASE_MAX;
+    changed = map.debounce_ms != featureReport[3]
+           || map.keepalive != featureReport[4]
+           || map.sof_phase != sofPhase
+           || map.personality != featureReport[6]
+           || memcmp(&map.profile[window], &newProfile, sizeof(newProfile)) != 0;
+
+    if (changed) {
+        Mapping_StoreGlobal(&featureReport[3]);
+        Mapping_StoreProfile(window, &newProfile);
+
+        Mapping_Apply();
+        Mapping_Save();
+    }
+
+    // Byte 41: switching the active profile does not touch the flash
+    if (active != activeProfile) Mapping_SelectProfile(active);
 }
 
 /**
@@ -194,9 +838,207 @@ void Mapping_SetFromFeatureReport(uint8_t* featureReport, uint16_t length) {
  * @param featureReport The feature report buffer to be sent to the host
  */
 void Mapping_GetAsFeatureReport(uint8_t* featureReport) {
-    // Copy entire map structure (64 bytes) directly
-    memcpy(featureReport, &map, sizeof(map));
-    
-    // Ensure Report ID is set correctly
-    featureReport[0] = 0x00;  // Report ID 0
-}
\ No newline at end of file
+    const MAP_PROFILE *p = &map.profile[windowProfile];
+    uint8_t *dst = &featureReport[MAP_RPT_PROFILE_OFFSET];
+
+    memset(featureReport, 0, MAP_RPT_STATUS_OFFSET);
+    featureReport[0] = MAP_REPORT_ID;
+    featureReport[1] = MAP_VER;
+    featureReport[3] = map.debounce_ms;
+    featureReport[4] = map.keepalive;
+    featureReport[5] = map.sof_phase;
+    featureReport[6] = map.personality;
+
+    // Bytes 7-28: the window profile
+    *dst++ = p->socd;
+    memcpy(dst, p->tbl, NUM_BUTTONS);
+    dst += NUM_BUTTONS;
+    memcpy(dst, p->turbo, NUM_BUTTONS);
+    dst += NUM_BUTTONS;
+    *dst++ = p->crosskey;
+    memcpy(dst, p->name, PROFILE_NAME_LEN);
+
+    featureReport[MAP_RPT_WINDOW_OFFSET] = windowProfile;
+    featureReport[MAP_RPT_ACTIVE_OFFSET] = activeProfile;
+    featureReport[MAP_RPT_COUNT_OFFSET] = MAP_PROFILES;
+    featureReport[2] = crc8(featureReport, MAP_RPT_STATUS_OFFSET);
+
+    // Runtime status (not stored in flash)
+    featureReport[MAP_RPT_STATUS_OFFSET] = Mapping_GetStatus();
+}
+
+/**
+ * Write or select a tag through the tag feature report
+ * @param report [MAP_TAG_REPORT_ID, tag, value...] received from the host
+ * @param length Length of the report data
+ */
+void Mapping_SetTagReport(const uint8_t* report, uint8_t length) {
+    uint8_t tag;
+    uint8_t known;
+    uint8_t before[15];
+    uint8_t after[15];
+
+    if (length < 2) return;
+    tag = report[1];
+
+    // A tag without a value selects the tag of the next GET_REPORT
+    if (MAP_TAG_LEN(tag) == 0) {
+        tagSelect = MAP_TAG_TYPE(tag);
+        return;
+    }
+    tagSelect = MAP_TAG_TYPE(tag);
+    if (length < 2 + MAP_TAG_LEN(tag)) {
+        commitStatus = MAP_STATUS_FAILED;
+        return;
+    }
+
+    // Only a change is written to the flash
+    known = MAP_TAG_LEN(Mapping_GetTagValue(tagSelect, before));
+    if (!Mapping_SetTagValue(tag, &report[2])) {
+        commitStatus = MAP_STATUS_FAILED;
+        return;
+    }
+    Mapping_GetTagValue(tagSelect, after);
+    if (memcmp(before, after, known) != 0) {
+        Mapping_Apply();
+        Mapping_Save();
+    }
+}
+
+/**
+ * Copy the selected tag to the tag feature report
+ * @param report Buffer of at least MAP_TAG_RPT_LEN bytes
+ * @return Length of the report: [MAP_TAG_REPORT_ID, tag, value...]
+ */
+uint8_t Mapping_GetTagReport(uint8_t* report) {
+    uint8_t tag = Mapping_GetTagValue(tagSelect, &report[2]);
+
+    report[0] = MAP_TAG_REPORT_ID;
+    report[1] = tag;
+    return (uint8_t)(2 + MAP_TAG_LEN(tag));
+}
+
+/**
+ * Change a copy of a profile as a set command asks
+ * @param p Profile to change
+ * @param cmd [op, ...] arguments of MAP_CMD_SET_ENTRY or MAP_CMD_SET_RANGE
+ * @param length Bytes from op on
+ * @return false if the arguments do not fit the profile
+ */
+static bool Mapping_EditProfile(MAP_PROFILE *p, const uint8_t *cmd, uint8_t length) {
+    uint8_t first;
+    uint8_t count;
+
+    if (cmd[0] == MAP_CMD_SET_ENTRY) {
+        // [op, profile, button, usage, turbo]
+        if (length < 5) return false;
+        first = cmd[2];
+        if (first >= NUM_BUTTONS) return false;
+        p->tbl[first] = cmd[3];
+        p->turbo[first] = cmd[4];
+        return true;
+    }
+
+    // [op, profile, first, count, value...]: bytes of the report window image
+    if (length < 4) return false;
+    first = cmd[2];
+    count = cmd[3];
+    if (count > length - 4 || first > MAP_RPT_PROFILE_LEN || count > MAP_RPT_PROFILE_LEN - first) {
+        return false;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        uint8_t off = first + i;
+        uint8_t v = cmd[4 + i];
+
+        if (off == 0) {
+            p->socd = v;
+        } else if (off <= NUM_BUTTONS) {
+            p->tbl[off - 1] = v;
+        } else if (off <= 2 * NUM_BUTTONS) {
+            p->turbo[off - 1 - NUM_BUTTONS] = v;
+        } else if (off == 2 * NUM_BUTTONS + 1) {
+            p->crosskey = v;
+        } else {
+            p->name[off - 2 - 2 * NUM_BUTTONS] = v;
+        }
+    }
+    return true;
+}
+
+/**
+ * Run a command of the command feature report
+ * @param cmd [op, ...] (the report without its ID)
+ * @param length Bytes from op on
+ * @return false if the command was rejected (the RAM map is not changed)
+ */
+static bool Mapping_RunCommand(const uint8_t *cmd, uint8_t length) {
+    MAP_PROFILE p;
+    uint8_t n;
+
+    switch (cmd[0]) {
+        case MAP_CMD_SET_ENTRY:
+        case MAP_CMD_SET_RANGE:
+            if (length < 2) return false;
+            n = cmd[1];
+            if (n >= MAP_PROFILES) return false;
+            p = map.profile[n];
+            if (!Mapping_EditProfile(&p, cmd, length) || !Mapping_ProfileIsValid(&p)) return false;
+
+            if (memcmp(&map.profile[n], &p, sizeof(p)) != 0) {
+                Mapping_StoreProfile(n, &p);
+                if (n == activeProfile) Mapping_Compile();
+            }
+            return true;
+
+        case MAP_CMD_APPLY:
+            // [op, tag, value...]: a whole tag, without saving
+            if (length < 2 || length - 2 < MAP_TAG_LEN(cmd[1])) return false;
+            if (!Mapping_SetTagValue(cmd[1], &cmd[2])) return false;
+            Mapping_Apply();
+            return true;
+
+        case MAP_CMD_COMMIT:
+            // Everything changed since the last save goes to the flash at once
+            if (changedTags) Mapping_Save();
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+/**
+ * Run a command received through the command feature report
+ * @param report [MAP_CMD_REPORT_ID, op, ...] received from the host
+ * @param length Length of the report data
+ */
+void Mapping_SetCommandReport(const uint8_t* report, uint8_t length) {
+    if (length < 2) {
+        // Only the report ID: no command to run
+        cmdOp = 0;
+        cmdResult = MAP_CMD_REJECTED;
+        commitStatus = MAP_STATUS_FAILED;
+        return;
+    }
+
+    cmdOp = report[1];
+    if (Mapping_RunCommand(&report[1], (uint8_t)(length - 1))) {
+        cmdResult = MAP_CMD_OK;
+    } else {
+        cmdResult = MAP_CMD_REJECTED;
+        commitStatus = MAP_STATUS_FAILED;
+    }
+}
+
+/**
+ * Copy the result of the last command to the command feature report
+ * @param report Buffer of at least MAP_CMD_RESULT_LEN bytes
+ * @return Length of the report: [MAP_CMD_REPORT_ID, op, result, status]
+ */
+uint8_t Mapping_GetCommandReport(uint8_t* report) {
+    report[0] = MAP_CMD_REPORT_ID;
+    report[1] = cmdOp;
+    report[2] = cmdResult;
+    report[3] = Mapping_GetStatus();
+    return MAP_CMD_RESULT_LEN;
+}
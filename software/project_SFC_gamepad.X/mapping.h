@@ -10,6 +10,114 @@ Mapping functionality for button-to-usage configuration
 #include <stdint.h>
 
 #define NUM_BUTTONS 8  // SFCは8ボタン（十字キー除く）
+#define NUM_USAGES  15 // usage 0(無効) + 1-14
+
+#define MAP_PROFILES     4  // ボタンマッピングのプロファイル数
+#define PROFILE_NAME_LEN 4  // プロファイル名のバイト数 (ASCII, 短い名前は 0 埋め)
+#define CROSSKEY_MODES   3  // クロスキーモード: 0 = X/Y, 1 = HAT, 2 = Z/Rz
+#define MAP_TURBO_MAX    15 // 連射の半周期の最大値 (USB フレーム数)
+
+/* ────────────────────────────────────────────────────────────────────────────
+   Mapping feature report (interface 1, report ID MAP_REPORT_ID, 64 bytes)
+     byte 0      report ID (1)
+     byte 1      MAP_VER
+     byte 2      CRC8 of bytes 0-58 with this byte as 0
+     bytes 3-6   debounce_ms, keepalive, sof_phase, personality
+     bytes 7-28  window profile: socd, table[8], turbo[8], crosskey, name[4]
+     byte 40     window profile (the profile bytes 7-28 show and write)
+     byte 41     active profile
+     byte 42     number of profiles (read only)
+     bytes 59-63 runtime status on GET_REPORT
+   A SET_REPORT that moves the window (byte 40) only moves it, so that the
+   next GET_REPORT reads the other profile. Switching the active profile
+   (byte 41) never writes the flash; the flash is written only when the
+   window profile or a global setting changes.
+   ──────────────────────────────────────────────────────────────────────────── */
+#define MAP_REPORT_ID           1
+#define MAP_RPT_PROFILE_OFFSET  7  // window profile data (bytes 7-28)
+#define MAP_RPT_PROFILE_LEN     22
+#define MAP_RPT_WINDOW_OFFSET   40 // window profile index
+#define MAP_RPT_ACTIVE_OFFSET   41 // active profile index
+#define MAP_RPT_COUNT_OFFSET    42 // MAP_PROFILES
+#define MAP_RPT_STATUS_OFFSET   59 // flash commit status (MAP_STATUS_*)
+
+/* ────────────────────────────────────────────────────────────────────────────
+   Mapping tags (HEF log entries and tag feature report)
+     tag byte    high nibble = value length (0-15), low nibble = type
+     value       length bytes
+   A reader skips unknown types by their length and uses the first bytes of
+   a longer value, so new tags and longer values stay readable. 0xFF (erased
+   flash) ends the entries of a log row; a save appends only changed tags.
+     MAP_TAG_GLOBAL      debounce_ms, keepalive, sof_phase, personality
+     MAP_TAG_PROFILE+n   profile n: name[4], table[4], turbo[4], mode
+                         (2 values per table / turbo byte, low nibble first;
+                          mode bits 0-1 SOCD horizontal, 2-3 SOCD vertical,
+                          4-5 crosskey)
+
+   Tag feature report (interface 1, report ID MAP_TAG_REPORT_ID)
+     SET [3, tag, value...]  writes the tag (the flash only if it changed)
+     SET [3, MAP_TAG(type, 0)] selects the tag of the next GET_REPORT
+     GET [3, tag, value...]  the selected tag, MAP_TAG(type, 0) if unknown
+   The report is declared MAP_TAG_RPT_LEN bytes long; bytes past the tag's
+   value are ignored on SET and left out on GET.
+   Errors are reported in the status byte of the mapping feature report.
+   ──────────────────────────────────────────────────────────────────────────── */
+#define MAP_TAG(type, len)  ((uint8_t)(((len) << 4) | (type)))
+#define MAP_TAG_TYPE(tag)   ((uint8_t)((tag) & 0x0F))
+#define MAP_TAG_LEN(tag)    ((uint8_t)((tag) >> 4))
+#define MAP_TAG_END         0xFF
+
+#define MAP_TAG_PAD         0x0    // no value, skipped
+#define MAP_TAG_GLOBAL      0x1
+#define MAP_TAG_PROFILE     0x8    // 0x8-0xB: profile 0-3
+
+#define MAP_TAG_GLOBAL_LEN  4
+#define MAP_TAG_PROFILE_LEN 13
+
+#define MAP_TAG_REPORT_ID   3
+#define MAP_TAG_RPT_LEN     17 // report ID, tag and the longest value
+
+/* ────────────────────────────────────────────────────────────────────────────
+   Mapping command feature report (interface 1, report ID MAP_CMD_REPORT_ID)
+     SET [4, op, args...], as short as the command:
+       MAP_CMD_SET_ENTRY  profile, button, usage, turbo
+       MAP_CMD_SET_RANGE  profile, first, count, value[count]
+                          (offsets of the window image, bytes 7-28 of the
+                           mapping report minus 7: socd, table, turbo, ...)
+       MAP_CMD_APPLY      tag, value... (a whole MAP_TAG_* tag)
+       MAP_CMD_COMMIT     (no arguments)
+     GET [4, op, result, status] of the last command
+   The report is declared MAP_CMD_RPT_LEN bytes long; bytes past the
+   command are ignored.
+   A command takes effect within its control transfer and writes no flash;
+   MAP_CMD_COMMIT writes everything changed since the last save at once.
+   A rejected command changes nothing.
+   ──────────────────────────────────────────────────────────────────────────── */
+#define MAP_CMD_REPORT_ID   4
+#define MAP_CMD_RPT_LEN     (5 + MAP_RPT_PROFILE_LEN) // longest SET: a whole window
+#define MAP_CMD_RESULT_LEN  4
+
+enum {
+    MAP_CMD_SET_ENTRY = 0x01,
+    MAP_CMD_SET_RANGE = 0x02,
+    MAP_CMD_APPLY = 0x03,
+    MAP_CMD_COMMIT = 0x04
+};
+
+enum {
+    MAP_CMD_OK = 0,
+    MAP_CMD_REJECTED = 1
+};
+
+/* Flash commit status */
+enum {
+    MAP_STATUS_COMMITTED = 0,   // RAM mapping is stored in flash
+    MAP_STATUS_PENDING = 1,     // RAM mapping is applied, flash write pending
+    MAP_STATUS_FAILED = 2,      // last update was rejected or the flash write failed
+    MAP_STATUS_UNSAVED = 3      // RAM mapping is applied, waits for MAP_CMD_COMMIT
+};
+
+#define SOF_PHASE_MAX 44 // Timer0 1tick = 256/12MHz = 21.3us, 1 frame = 46.9 ticks
 
 // 物理ボタンインデックス
 enum {
@@ -24,29 +132,99 @@ enum {
 };
 
 /**
- * convert mapping data structure to row buffer for flash write
+ * Compiled mapping entry: if the physical button's snapshot bit is set,
+ * OR mask into INPUT_CONTROLS.val[idx]. Unmapped buttons have mask 0.
  */
-void map_to_rowbuf(void);
+typedef struct {
+    uint16_t snap;  // BUTTON_Snapshot() bit of the physical button
+    uint8_t idx;    // byte index in INPUT_CONTROLS.val[]
+    uint8_t mask;   // bit to set in that byte
+    uint8_t turbo;  // turbo half period in USB frames (0 = off)
+} MAP_ENTRY;
 
 /**
- * Load mapping from High-Endurance Flash to RAM
+ * Load the mapping from the High-Endurance Flash log
  */
 void Mapping_Load(void);
 
 /**
- * Save mapping from RAM to High-Endurance Flash
- * @param normal_tbl Pointer to normal mode button-to-usage mapping table (at least NUM_BUTTONS bytes)
- * @param special_tbl Pointer to special mode button-to-usage mapping table (at least NUM_BUTTONS bytes)
+ * Schedule the High-Endurance Flash write of the changed mapping tags
+ * Mapping_Tasks() appends them to the log.
+ */
+void Mapping_Save(void);
+
+/**
+ * Run one step (erase or write) of a pending High-Endurance Flash commit
+ * Call this from the main loop right after a report has been armed.
  */
-void Mapping_Save(const uint8_t *normal_tbl, const uint8_t *special_tbl);
+void Mapping_Tasks(void);
 
 /**
  * Get the usage value for a physical button
  * @param physBtn Physical button index (0-7)
- * @param mode Mode selection (0=normal, 1=special)
+ * @param profile Profile index (0 to MAP_PROFILES-1)
  * @return Usage value (1-14)
  */
-uint8_t Mapping_GetUsage(uint8_t physBtn, uint8_t mode);
+uint8_t Mapping_GetUsage(uint8_t physBtn, uint8_t profile);
+
+/**
+ * Make a profile the active one
+ * The profile is compiled into the resident table and its SOCD policy and
+ * crosskey mode take effect at once; the flash is not touched.
+ * @param profile Profile index (0 to MAP_PROFILES-1), others are ignored
+ */
+void Mapping_SelectProfile(uint8_t profile);
+
+/**
+ * Get the active profile
+ * @return Profile index (0 to MAP_PROFILES-1)
+ */
+uint8_t Mapping_GetProfile(void);
+
+/**
+ * Get the compiled mapping table of the active profile
+ * The table is rebuilt in place when the profile is switched or changed,
+ * so the returned pointer stays valid.
+ * @return Table of NUM_BUTTONS entries, one per physical button
+ */
+const MAP_ENTRY* Mapping_GetCompiled(void);
+
+/**
+ * Get the buttons with turbo in the active profile
+ * @return BUTTON_SNAP_* bits of the buttons whose compiled entry has turbo
+ */
+uint16_t Mapping_GetTurboMask(void);
+
+/**
+ * Get the crosskey mode in use
+ * @return Crosskey mode (0 to CROSSKEY_MODES-1)
+ */
+uint8_t Mapping_GetCrosskey(void);
+
+/**
+ * Change the crosskey mode in use until the next profile switch
+ * The stored mode of the profile is not changed.
+ * @param mode Crosskey mode (0 to CROSSKEY_MODES-1), others are ignored
+ */
+void Mapping_SetCrosskey(uint8_t mode);
+
+/**
+ * Get the report-on-change keep-alive period
+ * @return Period in 4ms units (0 = report-on-change disabled)
+ */
+uint8_t Mapping_GetKeepAlive(void);
+
+/**
+ * Get the SOF synchronized sampling phase
+ * @return Phase after SOF in Timer0 ticks (0 = sample as soon as possible)
+ */
+uint8_t Mapping_GetSOFPhase(void);
+
+/**
+ * Get the stored USB personality
+ * @return Personality ID (PERSONALITY_*) selected when no boot button is held
+ */
+uint8_t Mapping_GetPersonality(void);
 
 /**
  * Copy mapping data from Feature Report buffer to the mapping table
@@ -61,4 +239,36 @@ void Mapping_SetFromFeatureReport(uint8_t* featureReport, uint16_t length);
  */
 void Mapping_GetAsFeatureReport(uint8_t* featureReport);
 
+/**
+ * Write or select a tag through the tag feature report
+ * A tag with a value is written to RAM at once and scheduled for the flash
+ * if it changed; a tag without a value selects the tag read next.
+ * @param report [MAP_TAG_REPORT_ID, tag, value...] received from the host
+ * @param length Length of the report data
+ */
+void Mapping_SetTagReport(const uint8_t* report, uint8_t length);
+
+/**
+ * Copy the selected tag to the tag feature report
+ * @param report Buffer of at least MAP_TAG_RPT_LEN bytes
+ * @return Length of the report: [MAP_TAG_REPORT_ID, tag, value...]
+ */
+uint8_t Mapping_GetTagReport(uint8_t* report);
+
+/**
+ * Run a command received through the command feature report
+ * Changes take effect at once but stay in RAM until MAP_CMD_COMMIT.
+ * A report without the op byte is rejected.
+ * @param report [MAP_CMD_REPORT_ID, op, args...] received from the host
+ * @param length Length of the report data
+ */
+void Mapping_SetCommandReport(const uint8_t* report, uint8_t length);
+
+/**
+ * Copy the result of the last command to the command feature report
+ * @param report Buffer of at least MAP_CMD_RESULT_LEN bytes
+ * @return Length of the report: [MAP_CMD_REPORT_ID, op, result, status]
+ */
+uint8_t Mapping_GetCommandReport(uint8_t* report);
+
 #endif /* _MAPPING_H */
\ No newline at end of file
@@ -23,178 +23,247 @@ limitations under the License.
 #include "usb.h"
 #include "usb_device_hid.h"
 #include "mapping.h"
+#include "usb_personality.h"
+#include "socd.h"
+#include "macro.h"
 
-typedef struct _Flags{
-    uint8_t crosskey_flag :2 ;
-    uint8_t sw_flag :1 ;
-    uint8_t :5 ;
-} Flags;
+#define MODE_HOLD_TICKS 250     // モード切替の長押し tick 数 (Timer0 1周 約5.5ms x 250)
 
+typedef struct _ComboHold{
+    uint8_t cnt;                // 長押し経過 tick 数
+    uint8_t latched :1 ;        // 切替済み、離されるまで再判定しない
+    uint8_t :7 ;
+} ComboHold;
 
-Flags flags;
+static ComboHold holdSW;        // Start + R : プロファイル切替
+static ComboHold holdCrosskey;  // Start + L : クロスキーモード切替
+static ComboHold holdRecord;    // Select + L : マクロ記録の開始 / 停止
+static ComboHold holdPlay;      // Select + R : マクロ再生の開始 / 停止
 
-/* ────────────────────────────────────────────────────────────────────────────
-   usageByte[usage]: 
-     usage (1–14) が INPUT_CONTROLS.val[] の何バイト目に対応するか
-   ──────────────────────────────────────────────────────────────────────────── */
-static const uint8_t usageByte[15] = {
-    /*  0: 未使用 (無効) */  0,
-    /*  1: A            */  0,    // val[0].bit0
-    /*  2: B            */  0,    // val[0].bit1
-    /*  3: X            */  0,    // val[0].bit2
-    /*  4: Y            */  0,    // val[0].bit3
-    /*  5: L1           */  0,    // val[0].bit4
-    /*  6: R1           */  0,    // val[0].bit5
-    /*  7: Select       */  0,    // val[0].bit6
-    /*  8: Start        */  0,    // val[0].bit7
-    /*  9: L2           */  1,    // val[1].bit0
-    /* 10: R2           */  1,    // val[1].bit1
-    /* 11: Home         */  1,    // val[1].bit2
-    /* 12: Right Stick  */  1,    // val[1].bit3
-    /* 13: Left Stick   */  1,    // val[1].bit4
-    /* 14: Z (unused)   */  1     // val[1].bit5
-};
+static const MAP_ENTRY* activeMap;  // 使用中プロファイルのコンパイル済みマッピング
 
 /* ────────────────────────────────────────────────────────────────────────────
-   usageMask[usage]:
-     各 usage (1–14) がそのバイト内で何ビット目かを表すマスク
+   連射 (ターボ)
+     MAP_ENTRY.turbo = n のボタンは押している間 n フレーム ON、n フレーム OFF
+     を繰り返す。区間は USB フレーム (SOF ごとに進む USBGet1msTickCount())
+     で数えるので、1フレーム1回のホストポーリングと常に揃いエイリアシング
+     しない。押した瞬間は ON 区間から始まるので押下の遅延は増えない。
+     連射設定の無いプロファイルではフレーム番号を記録するだけで戻る。
+     プロファイルが切り替わったら (コンボでもフィーチャーレポートでも)
+     連射の状態を捨てる。
    ──────────────────────────────────────────────────────────────────────────── */
-static const uint8_t usageMask[15] = {
-    /*  0: 無効      */  0x00,
-    /*  1: A         */  1 << 0,  // val[0] bit0 → a
-    /*  2: B         */  1 << 1,  // val[0] bit1 → b
-    /*  3: X         */  1 << 2,  // val[0] bit2 → x
-    /*  4: Y         */  1 << 3,  // val[0] bit3 → y
-    /*  5: L1        */  1 << 4,  // val[0] bit4 → L1
-    /*  6: R1        */  1 << 5,  // val[0] bit5 → R1
-    /*  7: Select    */  1 << 6,  // val[0] bit6 → select
-    /*  8: Start     */  1 << 7,  // val[0] bit7 → start
-    /*  9: L2        */  1 << 0,  // val[1] bit0 → L2
-    /* 10: R2        */  1 << 1,  // val[1] bit1 → R2
-    /* 11: Home      */  1 << 2,  // val[1] bit2 → home
-    /* 12: RightStick*/  1 << 3,  // val[1] bit3 → right_stick
-    /* 13: LeftStick */  1 << 4,  // val[1] bit4 → left_stick
-    /* 14: Z (unused)*/  1 << 5   // val[1] bit5 → unused
-};
+static uint16_t turboOff;               // OFF 区間にあるボタン (BUTTON_SNAP_* bits)
+static uint8_t turboLeft[NUM_BUTTONS];  // 現区間の残りフレーム数 (0 = 押されていない)
+static uint8_t turboFrame;              // 最後に進めた USB フレーム (下位8bit)
+static uint8_t turboProfile;            // 連射の状態を持つプロファイル
+
+/* 連射の状態を捨てる (プロファイル切替時) */
+static void App_DeviceGamepadTurboReset(void){
+    turboProfile = Mapping_GetProfile();
+    turboOff = 0;
+    memset(turboLeft, 0, sizeof(turboLeft));
+}
+
+/* 連射の OFF 区間にあるボタンを snap から落とす */
+static uint16_t App_DeviceGamepadTurbo(uint16_t snap){
+    uint16_t mask = Mapping_GetTurboMask();
+    uint8_t frame = (uint8_t)USBGet1msTickCount();
+    uint8_t elapsed = (uint8_t)(frame - turboFrame);
+
+    turboFrame = frame;
+    if(Mapping_GetProfile() != turboProfile) App_DeviceGamepadTurboReset();
+    if(mask == 0) return snap;
+
+    const MAP_ENTRY* e = activeMap;
+    for(uint8_t i = 0; i < NUM_BUTTONS; i++, e++){
+        if(e->turbo == 0) continue;
 
-/* 物理 idx をハードボタンに変換して押下を調べる関数 */
-static bool isPhysPressed(uint8_t phys)
-{
-    switch(phys){
-        case PHYS_BTN_A:      return BUTTON_IsPressed(BUTTON_A);
-        case PHYS_BTN_B:      return BUTTON_IsPressed(BUTTON_B);
-        case PHYS_BTN_X:      return BUTTON_IsPressed(BUTTON_X);
-        case PHYS_BTN_Y:      return BUTTON_IsPressed(BUTTON_Y);
-        case PHYS_BTN_L:      return BUTTON_IsPressed(BUTTON_TL);
-        case PHYS_BTN_R:      return BUTTON_IsPressed(BUTTON_TR);
-        case PHYS_BTN_START:  return BUTTON_IsPressed(BUTTON_START);
-        case PHYS_BTN_SELECT: return BUTTON_IsPressed(BUTTON_SELECT);
-        default: return false;   // no physical button for this index
+        if(!(snap & e->snap)){
+            // 離した: 次に押したら ON 区間から
+            turboLeft[i] = 0;
+            turboOff &= (uint16_t)~e->snap;
+        }else if(turboLeft[i] == 0){
+            // 押した瞬間: ON 区間の始まり
+            turboLeft[i] = e->turbo;
+            turboOff &= (uint16_t)~e->snap;
+        }else{
+            // 経過フレーム分だけ区間を進める (通常は 0 か 1)
+            uint8_t steps = elapsed;
+            while(steps >= turboLeft[i]){
+                steps -= turboLeft[i];
+                turboLeft[i] = e->turbo;
+                turboOff ^= e->snap;
+            }
+            turboLeft[i] -= steps;
+        }
     }
+    // 連射を外したボタンに古い OFF 区間が残っていても無視する
+    return snap & (uint16_t)~(turboOff & mask);
 }
 
 void App_DeviceGamepadInit(void){
-    flags.crosskey_flag = 0;
-    flags.sw_flag = false;    
+    // 再構成でプロファイル 0 (保存されたクロスキーモード) に戻す
+    Mapping_SelectProfile(0);
+    activeMap = Mapping_GetCompiled();
+    App_DeviceGamepadTurboReset();
+
+    holdSW.cnt = 0;
+    holdSW.latched = 0;
+    holdCrosskey.cnt = 0;
+    holdCrosskey.latched = 0;
+    holdRecord.cnt = 0;
+    holdRecord.latched = 0;
+    holdPlay.cnt = 0;
+    holdPlay.latched = 0;
+
+    // 再構成で止める (記録中ならそこまでを保存する)
+    Macro_Stop();
 }
 
-void App_DeviceGamepadAct(INPUT_CONTROLS* gamepad_input){
+/* ────────────────────────────────────────────────────────────────────────────
+   crosskeyTable[dpad]:
+     十字キー 4bit (CROSSKEY_INDEX()) ごとの HAT 値と左右・上下の軸値
+     3つのクロスキーモードとも1回の表引きで決まり、方向によって処理時間が
+     変わらない。左右・上下の同時押しは SOCD_Clean() で解決済みなので
+     通常は来ないが、来た場合はその軸をニュートラルとして扱う。
+   ──────────────────────────────────────────────────────────────────────────── */
+#define AXIS_MIN    0x00
+#define AXIS_MID    0x80
+#define AXIS_MAX    0xFF
 
-    // Clear all button fields and data by zeroing all bytes
-    memset(gamepad_input->val, 0, sizeof(gamepad_input->val));
-    
-    // D-Padの状態を取得（全ての処理で使えるように上部で定義）
-    bool up = BUTTON_IsPressed(BUTTON_UP);
-    bool down = BUTTON_IsPressed(BUTTON_DOWN);
-    bool left = BUTTON_IsPressed(BUTTON_LEFT);
-    bool right = BUTTON_IsPressed(BUTTON_RIGHT);
-
-    // マッピングテーブル駆動でボタン処理
-    for (uint8_t phys = 0; phys < NUM_BUTTONS; phys++){
-        if(!isPhysPressed(phys)) continue;          // 押されていなければスキップ
-
-        uint8_t usage = Mapping_GetUsage(phys, flags.sw_flag);  // sw_flagでモード選択
-        if(!usage || usage >= 15) continue;             // 無効は無視
-
-        uint8_t idx  = usageByte[usage];               // val のバイト番号
-        uint8_t mask = usageMask[usage];               // 立てるビット
-        gamepad_input->val[idx] |= mask;               // ワンショットでセット
-    }
+typedef struct {
+    uint8_t hat;    // HAT_SWITCH_*
+    uint8_t h;      // 左右の軸値 (X / Z)
+    uint8_t v;      // 上下の軸値 (Y / Rz)
+} CROSSKEY_ENTRY;
 
+static const CROSSKEY_ENTRY crosskeyTable[16] = {
+    /* ----  none        */  { HAT_SWITCH_NULL,       AXIS_MID, AXIS_MID },
+    /* ---L  W           */  { HAT_SWITCH_WEST,       AXIS_MIN, AXIS_MID },
+    /* --D-  S           */  { HAT_SWITCH_SOUTH,      AXIS_MID, AXIS_MAX },
+    /* --DL  SW          */  { HAT_SWITCH_SOUTH_WEST, AXIS_MIN, AXIS_MAX },
+    /* -R--  E           */  { HAT_SWITCH_EAST,       AXIS_MAX, AXIS_MID },
+    /* -R-L  SOCD: none  */  { HAT_SWITCH_NULL,       AXIS_MID, AXIS_MID },
+    /* -RD-  SE          */  { HAT_SWITCH_SOUTH_EAST, AXIS_MAX, AXIS_MAX },
+    /* -RDL  SOCD: S     */  { HAT_SWITCH_SOUTH,      AXIS_MID, AXIS_MAX },
+    /* U---  N           */  { HAT_SWITCH_NORTH,      AXIS_MID, AXIS_MIN },
+    /* U--L  NW          */  { HAT_SWITCH_NORTH_WEST, AXIS_MIN, AXIS_MIN },
+    /* U-D-  SOCD: none  */  { HAT_SWITCH_NULL,       AXIS_MID, AXIS_MID },
+    /* U-DL  SOCD: W     */  { HAT_SWITCH_WEST,       AXIS_MIN, AXIS_MID },
+    /* UR--  NE          */  { HAT_SWITCH_NORTH_EAST, AXIS_MAX, AXIS_MIN },
+    /* UR-L  SOCD: N     */  { HAT_SWITCH_NORTH,      AXIS_MID, AXIS_MIN },
+    /* URD-  SOCD: E     */  { HAT_SWITCH_EAST,       AXIS_MAX, AXIS_MID },
+    /* URDL  SOCD: none  */  { HAT_SWITCH_NULL,       AXIS_MID, AXIS_MID }
+};
 
-    // アナログスティック処理
-    // ハットスイッチはデフォルトでNULL(8)に設定
-    gamepad_input->members.hat_switch.hat_switch = HAT_SWITCH_NULL;
+/* 十字キー 4bit: bit0 左 (RC6), bit1 下 (RC7), bit2 右 (RB4), bit3 上 (RB7)
+   16bit シフトを避けてバイト単位で詰める */
+#define CROSSKEY_INDEX(snap) \
+    ((uint8_t)(((uint8_t)(snap) >> 6) \
+             | (((uint8_t)((snap) >> 8) >> 2) & 0x04) \
+             | (((uint8_t)((snap) >> 8) >> 4) & 0x08)))
 
-    // X/Y 初期化
-    gamepad_input->members.analog_stick.X = 0x80;  // デフォルト中央
-    gamepad_input->members.analog_stick.Y = 0x80;  // デフォルト中央
+/* クロスキー (十字キー) を現在のモードで HAT / X/Y / Z/Rz に変換する */
+static void App_DeviceGamepadCrosskey(INPUT_CONTROLS* gamepad_input, uint16_t snap){
+    const CROSSKEY_ENTRY* k = &crosskeyTable[CROSSKEY_INDEX(snap)];
 
-    // Z/Rz 初期化
-    gamepad_input->members.analog_stick.Z = 0x80;   // 中央位置 (128)
-    gamepad_input->members.analog_stick.Rz = 0x80;  // 中央位置 (128)
+    // 使わない出力は HAT = NULL(8)、アナログ軸 = 中央
+    gamepad_input->members.hat_switch.hat_switch = HAT_SWITCH_NULL;
+    gamepad_input->members.analog_stick.X = AXIS_MID;
+    gamepad_input->members.analog_stick.Y = AXIS_MID;
+    gamepad_input->members.analog_stick.Z = AXIS_MID;
+    gamepad_input->members.analog_stick.Rz = AXIS_MID;
 
     // クロスキーモード処理
-    switch(flags.crosskey_flag) {
+    switch(Mapping_GetCrosskey()) {
         // モード0: アナログX/Y
         case 0:
-            // X軸 (左右)
-            if(left){
-                gamepad_input->members.analog_stick.X = 0x00;   // 左
-            }else if(right){
-                gamepad_input->members.analog_stick.X = 0xFF; // 右
-            }
-            
-            // Y軸 (上下)
-            if(up){
-                gamepad_input->members.analog_stick.Y = 0x00;   // 上
-            }else if(down){
-                gamepad_input->members.analog_stick.Y = 0xFF; // 下
-            }
+            gamepad_input->members.analog_stick.X = k->h;
+            gamepad_input->members.analog_stick.Y = k->v;
             break;
-            
+
         // モード1: HATスイッチ
         case 1:
-            // HATスイッチ設定
-            if(up && left) {
-                gamepad_input->members.hat_switch.hat_switch = HAT_SWITCH_NORTH_WEST;
-            } else if(up && right) {
-                gamepad_input->members.hat_switch.hat_switch = HAT_SWITCH_NORTH_EAST;
-            } else if(down && left) {
-                gamepad_input->members.hat_switch.hat_switch = HAT_SWITCH_SOUTH_WEST;
-            } else if(down && right) {
-                gamepad_input->members.hat_switch.hat_switch = HAT_SWITCH_SOUTH_EAST;
-            } else if(up) {
-                gamepad_input->members.hat_switch.hat_switch = HAT_SWITCH_NORTH;
-            } else if(right) {
-                gamepad_input->members.hat_switch.hat_switch = HAT_SWITCH_EAST;
-            } else if(down) {
-                gamepad_input->members.hat_switch.hat_switch = HAT_SWITCH_SOUTH;
-            } else if(left) {
-                gamepad_input->members.hat_switch.hat_switch = HAT_SWITCH_WEST;
-            } else {
-                gamepad_input->members.hat_switch.hat_switch = HAT_SWITCH_NULL;
-            }
+            gamepad_input->members.hat_switch.hat_switch = k->hat;
             break;
-            
+
         // モード2: Z/RZ
         case 2:
-            // アナログスティックは中立に設定済み
-            gamepad_input->members.analog_stick.Z = left ? 0 : (right ? 255 : 128);
-            gamepad_input->members.analog_stick.Rz = up ? 0 : (down ? 255 : 128);
-    
+            gamepad_input->members.analog_stick.Z = k->h;
+            gamepad_input->members.analog_stick.Rz = k->v;
             break;
-            
-        // 不明なモード: モード0と同じ
+
+        // 不明なモード: 全て中立のまま
         default:
-            // ここには何も記述しない - 全てのモード処理は上のクロスキーモード処理で完了
             break;
     }
+}
+
+void App_DeviceGamepadAct(INPUT_CONTROLS* gamepad_input, uint16_t buttons){
+
+    // Clear all button fields and data by zeroing all bytes
+    memset(gamepad_input->val, 0, sizeof(gamepad_input->val));
     
+    // buttons はこのパスで1回だけ取った BUTTON_Snapshot()（1レポート内の整合性を保証）
+    // マクロ記録中はフレームごとに記録し、再生中はそのフレームの状態に置き換える
+    // 左右・上下の同時押しは SOCD ポリシーで解決し、各軸高々1方向にする
+    uint16_t snap = Macro_Sample(buttons, (uint16_t)USBGet1msTickCount());
+    snap = SOCD_Clean(snap);
+
+    // 連射の OFF 区間にあるボタンは押されていないものとして扱う
+    snap = App_DeviceGamepadTurbo(snap);
+
+    // コンパイル済みマッピングテーブルでボタン処理（押下ビットを OR するだけ）
+    const MAP_ENTRY* e = activeMap;
+    for (uint8_t n = NUM_BUTTONS; n; n--, e++){
+        if(snap & e->snap) gamepad_input->val[e->idx] |= e->mask;
+    }
+
+    // 十字キーは表引き1回で HAT / X/Y / Z/Rz に変換
+    App_DeviceGamepadCrosskey(gamepad_input, snap);
+
     return;
 
 }
 
+/* ────────────────────────────────────────────────────────────────────────────
+   switchButton[bit]:
+     汎用レポートのボタン (val[0] bit0 〜 val[1] bit7) が
+     Switch 互換レポートの何ビット目になるか
+   ──────────────────────────────────────────────────────────────────────────── */
+static const uint16_t switchButton[16] = {
+    /* a           */  1 << 2,   // A
+    /* b           */  1 << 1,   // B
+    /* x           */  1 << 3,   // X
+    /* y           */  1 << 0,   // Y
+    /* L1          */  1 << 4,   // L
+    /* R1          */  1 << 5,   // R
+    /* select      */  1 << 8,   // -
+    /* start       */  1 << 9,   // +
+    /* L2          */  1 << 6,   // ZL
+    /* R2          */  1 << 7,   // ZR
+    /* home        */  1 << 12,  // Home
+    /* right_stick */  1 << 11,  // RStick
+    /* left_stick  */  1 << 10,  // LStick
+    /* usage 14    */  1 << 13,  // Capture
+    /* filler      */  0,
+    /* filler      */  0
+};
+
+/* 汎用レポートを Switch 互換レポートに変換する
+   HAT (NULL = 8) と X/Y/Z/Rz (LX/LY/RX/RY) は同じ並びなのでボタンだけ並べ替える */
+void App_DeviceGamepadPackSwitch(uint8_t *report){
+    uint16_t in = (uint16_t)report[0] | ((uint16_t)report[1] << 8);
+    uint16_t out = 0;
+
+    for(uint8_t i = 0; in; i++, in >>= 1){
+        if(in & 1) out |= switchButton[i];
+    }
+    report[0] = (uint8_t)out;
+    report[1] = (uint8_t)(out >> 8);
+    report[7] = 0;      // vendor byte
+}
+
 /*cannot take address of bit-field.*/
 //void ChangeSWMode(bool* flag, BUTTON* button){
 //    uint16_t cnt_timer =0;
@@ -220,55 +289,74 @@ void App_DeviceGamepadAct(INPUT_CONTROLS* gamepad_input){
 //    return;
 //}
 
-void ChangeSWMode_Button_Start(void){
-    uint16_t cnt_timer =0;
-    
-    if (BUTTON_IsPressed(BUTTON_START)&&BUTTON_IsPressed(BUTTON_TR)){
-        INTCONbits.TMR0IF = 0;          // reset timer0 interrupt flag
-        TMR0bits.TMR0 = (uint8_t)5;
-        cnt_timer = 0;
-        while(BUTTON_IsPressed(BUTTON_START)&&BUTTON_IsPressed(BUTTON_TR)){
-            if(INTCONbits.TMR0IF){          // INTCONbits.TMR0IF happens every 4ms
-                cnt_timer++;
-                if(cnt_timer >=250){        // 2s
-                    flags.sw_flag = ~(flags.sw_flag);
-                    cnt_timer =0;
-                    while(BUTTON_IsPressed(BUTTON_START)&&BUTTON_IsPressed(BUTTON_TR));
-                }
-                INTCONbits.TMR0IF = 0;
-                TMR0bits.TMR0 = (uint8_t)5;
-            }
-        }
+/* ────────────────────────────────────────────────────────────────────────────
+   モード切替コンボの長押し判定
+     以前は while() で押下中ずっと待っていたため USBDeviceTasks() が呼ばれず
+     レポートも止まっていた。Timer0 のオーバーフロー(約5.5ms)を tick として
+     毎パス1回だけ進める non-blocking なステートマシンに置き換えている。
+   ──────────────────────────────────────────────────────────────────────────── */
+
+/* Timer0 が1周していれば true を返す
+   Timer0 は SOF 位相の計測にも使うため、再ロードせず free-running のまま */
+static bool ModeTimerTick(void){
+    if(!INTCONbits.TMR0IF) return false;
+
+    INTCONbits.TMR0IF = 0;
+    return true;
+}
+
+/* コンボが MODE_HOLD_TICKS 続いた瞬間だけ true を返す */
+static bool ComboHoldStep(ComboHold* hold, bool pressed, bool tick){
+    if(!pressed){
+        hold->cnt = 0;
+        hold->latched = 0;
+        return false;
     }
-        
-    return;
+    if(hold->latched || !tick) return false;
+
+    if(++hold->cnt >= MODE_HOLD_TICKS){
+        hold->cnt = 0;
+        hold->latched = 1;
+        return true;
+    }
+    return false;
 }
 
-void ChangeSWMode_Button_Select(void){
-    uint16_t cnt_timer =0;
-    
-    if (BUTTON_IsPressed(BUTTON_START)&&BUTTON_IsPressed(BUTTON_TL)){
-        INTCONbits.TMR0IF = 0;          // reset timer0 interrupt flag
-        TMR0bits.TMR0 = (uint8_t)5;
-        cnt_timer = 0;
-        while(BUTTON_IsPressed(BUTTON_START)&&BUTTON_IsPressed(BUTTON_TL)){
-            if(INTCONbits.TMR0IF){          // INTCONbits.TMR0IF happens every 4ms
-                cnt_timer++;
-                if(cnt_timer >=250){        // 2s
-                    switch(flags.crosskey_flag){
-                        case 0: flags.crosskey_flag =1; break;
-                        case 1: flags.crosskey_flag =2; break;
-                        case 2: flags.crosskey_flag =0; break;
-                    }
-                    cnt_timer =0;
-                    while(BUTTON_IsPressed(BUTTON_START)&&BUTTON_IsPressed(BUTTON_TL));
-                }
-                INTCONbits.TMR0IF = 0;
-                TMR0bits.TMR0 = (uint8_t)5;
-            }
+void App_DeviceGamepadModeTasks(uint16_t snap){
+    bool tick = ModeTimerTick();
+
+    // Start + R : 次のプロファイルへ切替 (RAM 上で再コンパイルするだけでフラッシュは触らない)
+    if(ComboHoldStep(&holdSW, (snap & (BUTTON_SNAP_START | BUTTON_SNAP_TR)) == (BUTTON_SNAP_START | BUTTON_SNAP_TR), tick)){
+        Mapping_SelectProfile((uint8_t)((Mapping_GetProfile() + 1) % MAP_PROFILES));
+    }
+
+    // Start + L : 十字キー機能 (X/Y -> HAT -> Z/Rz) の切替
+    if(ComboHoldStep(&holdCrosskey, (snap & (BUTTON_SNAP_START | BUTTON_SNAP_TL)) == (BUTTON_SNAP_START | BUTTON_SNAP_TL), tick)){
+        switch(Mapping_GetCrosskey()){
+            case 0: Mapping_SetCrosskey(1); break;
+            case 1: Mapping_SetCrosskey(2); break;
+            default: Mapping_SetCrosskey(0); break;
+        }
+    }
+
+    // Select + L : マクロ記録の開始 / 停止 (記録は離してから最初の押下で始まる)
+    if(ComboHoldStep(&holdRecord, (snap & (BUTTON_SNAP_SELECT | BUTTON_SNAP_TL)) == (BUTTON_SNAP_SELECT | BUTTON_SNAP_TL), tick)){
+        switch(Macro_GetState()){
+            case MACRO_IDLE:
+            case MACRO_PLAYING: Macro_Record(); break;
+            default: Macro_Stop(); break;
         }
     }
-        
+
+    // Select + R : マクロ再生の開始 / 停止 (このフレームから再生する)
+    if(ComboHoldStep(&holdPlay, (snap & (BUTTON_SNAP_SELECT | BUTTON_SNAP_TR)) == (BUTTON_SNAP_SELECT | BUTTON_SNAP_TR), tick)){
+        if(Macro_GetState() == MACRO_PLAYING){
+            Macro_Stop();
+        }else{
+            Macro_Play((uint16_t)USBGet1msTickCount());
+        }
+    }
+
     return;
 }
 
@@ -26,9 +26,8 @@ limitations under the License.
 #include "app_device_joystick.h"
 
 void App_DeviceGamepadInit(void);
-void App_DeviceGamepadAct(INPUT_CONTROLS* gamepad_input);
-void ChangeSWMode_Button_Start(void);
-void ChangeSWMode_Button_Select(void);
+void App_DeviceGamepadAct(INPUT_CONTROLS* gamepad_input, uint16_t buttons);
+void App_DeviceGamepadModeTasks(uint16_t snap);
 
 #endif	/* MY_APP_DEVICE_GAMEPAD_H */
 
@@ -0,0 +1,93 @@
+/*******************************************************************************
+Copyright 2025 Custom USB Gamepad Project
+
+SOCD (simultaneous opposite cardinal directions) cleaning
+*******************************************************************************/
+
+#include "socd.h"
+#include "io_mapping.h"
+
+/* ────────────────────────────────────────────────────────────────────────────
+   軸ごとに「どちらが先に押されたか」をサンプル単位で記録する
+     片方だけ押されていたサンプルの次に両方押されたら、前から押されていた
+     方が先。同じサンプルで両方押された場合は同着 (PRIORITY と同じく
+     左 / 上を勝たせる)。解決後のスナップショットは各軸高々1方向なので、
+     X/Y・HAT・Z/Rz のどのクロスキーモードでも同じ結果になる。
+   ──────────────────────────────────────────────────────────────────────────── */
+enum {
+    ORDER_TIE = 0,          // pressed in the same sample
+    ORDER_NEG_FIRST,        // left / up pressed first
+    ORDER_POS_FIRST         // right / down pressed first
+};
+
+typedef struct {
+    uint16_t neg;           // BUTTON_SNAP_LEFT / BUTTON_SNAP_UP
+    uint16_t pos;           // BUTTON_SNAP_RIGHT / BUTTON_SNAP_DOWN
+} SOCD_AXIS;
+
+static const SOCD_AXIS axes[2] = {
+    { BUTTON_SNAP_LEFT, BUTTON_SNAP_RIGHT },
+    { BUTTON_SNAP_UP,   BUTTON_SNAP_DOWN  }
+};
+
+static uint8_t policies[2];         // per axis (SOCD_*)
+static uint8_t order[2];            // per axis (ORDER_*)
+static uint16_t prevSnap;           // raw directions of the previous sample
+
+/**
+ * Set the resolution policies and forget the press order
+ * @param policy SOCD_POLICY(horizontal, vertical), invalid nibbles act as SOCD_PRIORITY
+ */
+void SOCD_SetPolicy(uint8_t policy) {
+    policies[0] = SOCD_HORIZONTAL(policy);
+    policies[1] = SOCD_VERTICAL(policy);
+    for (uint8_t i = 0; i < 2; i++) {
+        if (policies[i] >= SOCD_POLICY_COUNT) policies[i] = SOCD_PRIORITY;
+        order[i] = ORDER_TIE;
+    }
+    prevSnap = 0;
+}
+
+/**
+ * Resolve opposite directions of a button snapshot
+ * @param snap BUTTON_Snapshot() bits
+ * @return snap with at most one direction pressed per axis
+ */
+uint16_t SOCD_Clean(uint16_t snap) {
+    uint16_t raw = snap;
+
+    for (uint8_t i = 0; i < 2; i++) {
+        uint16_t neg = axes[i].neg;
+        uint16_t pos = axes[i].pos;
+        uint16_t both = neg | pos;
+
+        if ((snap & both) != both) continue;
+
+        // Both held: the press order is decided by the previous sample
+        if ((prevSnap & both) == neg) {
+            order[i] = ORDER_NEG_FIRST;
+        } else if ((prevSnap & both) == pos) {
+            order[i] = ORDER_POS_FIRST;
+        } else if ((prevSnap & both) == 0) {
+            order[i] = ORDER_TIE;
+        }
+
+        switch (policies[i]) {
+            case SOCD_NEUTRAL:
+                snap &= (uint16_t)~both;
+                break;
+            case SOCD_LAST_WINS:
+                snap &= (uint16_t)~((order[i] == ORDER_NEG_FIRST) ? neg : pos);
+                break;
+            case SOCD_FIRST_WINS:
+                snap &= (uint16_t)~((order[i] == ORDER_POS_FIRST) ? neg : pos);
+                break;
+            default:    // SOCD_PRIORITY
+                snap &= (uint16_t)~pos;
+                break;
+        }
+    }
+
+    prevSnap = raw;
+    return snap;
+}
@@ -0,0 +1,40 @@
+/*******************************************************************************
+Copyright 2025 Custom USB Gamepad Project
+
+SOCD (simultaneous opposite cardinal directions) cleaning
+*******************************************************************************/
+
+#ifndef _SOCD_H
+#define _SOCD_H
+
+#include <stdint.h>
+
+/* Resolution policy of one axis (left/right or up/down) */
+enum {
+    SOCD_PRIORITY = 0,      // left / up wins (behaviour before SOCD cleaning)
+    SOCD_NEUTRAL = 1,       // both cancel out
+    SOCD_LAST_WINS = 2,     // the direction pressed last wins
+    SOCD_FIRST_WINS = 3,    // the direction pressed first wins
+    SOCD_POLICY_COUNT
+};
+
+/* Stored policy byte: left/right in the low nibble, up/down in the high nibble */
+#define SOCD_POLICY(horizontal, vertical)   ((uint8_t)((horizontal) | ((vertical) << 4)))
+#define SOCD_HORIZONTAL(policy)             ((uint8_t)((policy) & 0x0F))
+#define SOCD_VERTICAL(policy)               ((uint8_t)((policy) >> 4))
+
+/**
+ * Set the resolution policies and forget the press order
+ * @param policy SOCD_POLICY(horizontal, vertical), invalid nibbles act as SOCD_PRIORITY
+ */
+void SOCD_SetPolicy(uint8_t policy);
+
+/**
+ * Resolve opposite directions of a button snapshot
+ * Call this once per sample: the press order is tracked between calls.
+ * @param snap BUTTON_Snapshot() bits
+ * @return snap with at most one direction pressed per axis
+ */
+uint16_t SOCD_Clean(uint16_t snap);
+
+#endif /* _SOCD_H */
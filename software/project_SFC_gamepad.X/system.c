@@ -22,9 +22,13 @@ please contact mla_licensing@microchip.com
  * 
  * Changes from the original source:
  *     - deleted unused function calls
+ *     - included usb.h for the USB_INTERRUPT build
+ *     - sleep through USB suspend, wake up on a button press
  ********************************************************************/
 
 #include "system.h"
+#include "usb.h"
+#include "latency.h"
 
 /** CONFIGURATION Bits **********************************************/
 // PIC16F1459 configuration bit settings:
@@ -73,6 +77,73 @@ please contact mla_licensing@microchip.com
     #pragma config LPBOR = OFF      // Low-Power Brown Out Reset (Low-Power BOR is disabled)
     #pragma config LVP = OFF        // Low-Voltage Programming Enable (High-voltage on MCLR/VPP must be used for programming)
 #endif
+
+static bool buttonWake;         // a button press ended the suspend sleep
+
+/*********************************************************************
+* Function: static void SYSTEM_SleepOnSuspend(void)
+*
+* Overview: Sleeps through the USB suspend.  The clock configuration
+*           is left as it is: only bus activity and the
+*           interrupt-on-change pins wake the core up.
+*           Returns when the host resumes (or resets) the bus, or when a
+*           button is pressed while the host has enabled remote wakeup.
+*
+* PreCondition: USBSuspend() has set SUSPND and the bus activity
+*               interrupt enable (ACTVIE)
+*
+* Input: None
+*
+* Output: None
+*
+********************************************************************/
+static void SYSTEM_SleepOnSuspend(void)
+{
+    bool gie = INTCONbits.GIE;
+    bool peie = INTCONbits.PEIE;
+    uint8_t pie2 = PIE2;
+
+    // Wake-up sources: bus activity (USB interrupt) and a press on the
+    // interrupt-on-change pins.  PORTC has none, so its buttons cannot
+    // end the sleep.  With GIE clear the core wakes up without vectoring
+    // to the ISR.
+    INTCONbits.GIE = 0;
+    PIE2bits.USBIE = 1;
+    INTCONbits.PEIE = 1;
+    IOCAN = BUTTON_IOC_A;
+    IOCBN = BUTTON_IOC_B;
+    IOCAF = 0;
+    IOCBF = 0;
+    INTCONbits.IOCIE = 1;
+
+    while(USBActivityIF == 0)
+    {
+        SLEEP();
+        NOP();
+
+        if((IOCAF | IOCBF) != 0)
+        {
+            IOCAF = 0;
+            IOCBF = 0;
+            if(USBGetRemoteWakeupStatus() == true)
+            {
+                Latency_Wake();
+                buttonWake = true;
+                break;
+            }
+        }
+    }
+
+    INTCONbits.IOCIE = 0;
+    IOCAN = 0;
+    IOCBN = 0;
+    IOCAF = 0;
+    IOCBF = 0;
+    PIE2 = pie2;
+    INTCONbits.PEIE = peie;
+    INTCONbits.GIE = gie;
+}
+
 /*********************************************************************
 * Function: void SYSTEM_Initialize( SYSTEM_STATE state )
 *
@@ -101,6 +172,7 @@ void SYSTEM_Initialize( SYSTEM_STATE state )
             break;
             
         case SYSTEM_STATE_USB_SUSPEND: 
+            SYSTEM_SleepOnSuspend();
             break;
             
         case SYSTEM_STATE_USB_RESUME:
@@ -108,6 +180,27 @@ void SYSTEM_Initialize( SYSTEM_STATE state )
     }
 }
 
+/*********************************************************************
+* Function: bool SYSTEM_ButtonWake(void)
+*
+* Overview: Tells whether a button press ended the last suspend sleep,
+*           and clears the flag
+*
+* PreCondition: None
+*
+* Input: None
+*
+* Output: true if a remote wakeup should be sent (USBCBSendResume())
+*
+********************************************************************/
+bool SYSTEM_ButtonWake(void)
+{
+    bool wake = buttonWake;
+
+    buttonWake = false;
+    return wake;
+}
+
 #if(__XC8_VERSION < 2000)
     #define INTERRUPT interrupt
 #else
@@ -65,6 +65,21 @@ typedef enum
 ********************************************************************/
 void SYSTEM_Initialize( SYSTEM_STATE state );
 
+/*********************************************************************
+* Function: bool SYSTEM_ButtonWake(void)
+*
+* Overview: Tells whether a button press ended the last USB suspend sleep
+*           (SYSTEM_Initialize(SYSTEM_STATE_USB_SUSPEND)), and clears it
+*
+* PreCondition: None
+*
+* Input: None
+*
+* Output: true if a remote wakeup should be sent (USBCBSendResume())
+*
+********************************************************************/
+bool SYSTEM_ButtonWake(void);
+
 /*********************************************************************
 * Function: void SYSTEM_Tasks(void)
 *
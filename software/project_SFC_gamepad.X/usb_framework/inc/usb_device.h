@@ -1306,6 +1306,31 @@ bool USBIsBusSuspended(void);
 #define USBIsBusSuspended() USBBusIsSuspended
 /*DOM-IGNORE-END*/
 
+/*******************************************************************************
+  Function:
+        bool USBCBSendResume(void)
+
+  Summary:
+    Sends the remote wakeup (resume) signalling to the host.
+
+  Description:
+    Checks that the host has enabled remote wakeup and that the bus is
+    suspended, then takes the device out of suspend and drives the resume
+    K-state onto the bus.  The host answers with its own resume signalling
+    and restarts the SOFs.
+
+  Conditions:
+    Call it from the main loop, not from a USB event handler: it raises
+    EVENT_RESUME itself.
+  Input:
+    None
+  Return:
+    true if the resume signalling was sent
+  Remarks:
+    Blocks for about 4ms (2ms of extra bus idle and 2ms of K-state).
+  *****************************************************************************/
+bool USBCBSendResume(void);
+
 /*******************************************************************************
   Function:
         void USBSoftDetach(void);
@@ -24,6 +24,10 @@ please contact mla_licensing@microchip.com
  * 
  * Changes from the original source:
  *     - comment out unused functions
+ *     - remote wakeup: USBCBSendResume(), DEVICE_REMOTE_WAKEUP only when
+ *       the configuration descriptor has _RWU, cleared on bus reset
+ *     - USBSuspend(), USBWakeFromSuspend() and USBCBSendResume() moved to
+ *       usb_device_suspend.c
  ********************************************************************/
 
 /*******************************************************************************
@@ -252,8 +256,6 @@ static void USBStdGetStatusHandler(void);
 static void USBStdFeatureReqHandler(void);
 static void USBCtrlTrfOutHandler(void);
 static void USBConfigureEndpoint(uint8_t EPNum, uint8_t direction);
-static void USBWakeFromSuspend(void);
-static void USBSuspend(void);
 static void USBStallHandler(void);
 
 // *****************************************************************************
@@ -350,6 +352,7 @@ void USBDeviceInit(void)
     USBDeferINDataStagePackets = false;
     USBDeferOUTDataStagePackets = false;
     USBBusIsSuspended = false;
+    RemoteWakeup = false;           //Disabled by a bus reset (USB 2.0 9.1.1.6)
 
     //Initialize all pBDTEntryIn[] and pBDTEntryOut[]
     //pointers to NULL, so they don't get used inadvertently.
@@ -2240,128 +2243,6 @@ static void USBStallHandler(void)
     USBClearInterruptFlag(USBStallIFReg,USBStallIFBitNum);
 }
 
-/********************************************************************
- * Function:        void USBSuspend(void)
- *
- * PreCondition:    None
- *
- * Input:           None
- *
- * Output:          None
- *
- * Side Effects:
- *
- * Overview:        This function handles if the host tries to
- *                  suspend the device
- *
- * Note:            None
- *******************************************************************/
-static void USBSuspend(void)
-{
-    /*
-     * NOTE: Do not clear UIRbits.ACTVIF here!
-     * Reason:
-     * ACTVIF is only generated once an IDLEIF has been generated.
-     * This is a 1:1 ratio interrupt generation.
-     * For every IDLEIF, there will be only one ACTVIF regardless of
-     * the number of subsequent bus transitions.
-     *
-     * If the ACTIF is cleared here, a problem could occur when:
-     * [       IDLE       ][bus activity ->
-     * <--- 3 ms ----->     ^
-     *                ^     ACTVIF=1
-     *                IDLEIF=1
-     *  #           #           #           #   (#=Program polling flags)
-     *                          ^
-     *                          This polling loop will see both
-     *                          IDLEIF=1 and ACTVIF=1.
-     *                          However, the program services IDLEIF first
-     *                          because ACTIVIE=0.
-     *                          If this routine clears the only ACTIVIF,
-     *                          then it can never get out of the suspend
-     *                          mode.
-     */
-    USBActivityIE = 1;                     // Enable bus activity interrupt
-    USBClearInterruptFlag(USBIdleIFReg,USBIdleIFBitNum);
-
-    #if defined(__18CXX) || defined(_PIC14E) || defined(__XC8)
-        U1CONbits.SUSPND = 1;                   // Put USB module in power conserve
-                                                // mode, SIE clock inactive
-    #endif
-    USBBusIsSuspended = true;
-    USBTicksSinceSuspendEnd = 0;
-
-    /*
-     * At this point the PIC can go into sleep,idle, or
-     * switch to a slower clock, etc.  This should be done in the
-     * USBCBSuspend() if necessary.
-     */
-    USB_SUSPEND_HANDLER(EVENT_SUSPEND,0,0);
-}
-
-/********************************************************************
- * Function:        void USBWakeFromSuspend(void)
- *
- * PreCondition:    None
- *
- * Input:           None
- *
- * Output:          None
- *
- * Side Effects:    None
- *
- * Overview:
- *
- * Note:            None
- *******************************************************************/
-static void USBWakeFromSuspend(void)
-{
-    USBBusIsSuspended = false;
-
-    /*
-     * If using clock switching, the place to restore the original
-     * microcontroller core clock frequency is in the USBCBWakeFromSuspend() callback
-     */
-    USB_WAKEUP_FROM_SUSPEND_HANDLER(EVENT_RESUME,0,0);
-
-    #if defined(__18CXX) || defined(_PIC14E) || defined(__XC8)
-        //To avoid improperly clocking the USB module, make sure the oscillator
-        //settings are consistent with USB operation before clearing the SUSPND bit.
-        //Make sure the correct oscillator settings are selected in the
-        //"USB_WAKEUP_FROM_SUSPEND_HANDLER(EVENT_RESUME,0,0)" handler.
-        U1CONbits.SUSPND = 0;   // Bring USB module out of power conserve
-                                // mode.
-    #endif
-
-
-    USBActivityIE = 0;
-
-    /********************************************************************
-    Bug Fix: Feb 26, 2007 v2.1
-    *********************************************************************
-    The ACTVIF bit cannot be cleared immediately after the USB module wakes
-    up from Suspend or while the USB module is suspended. A few clock cycles
-    are required to synchronize the internal hardware state machine before
-    the ACTIVIF bit can be cleared by firmware. Clearing the ACTVIF bit
-    before the internal hardware is synchronized may not have an effect on
-    the value of ACTVIF. Additionally, if the USB module uses the clock from
-    the 96 MHz PLL source, then after clearing the SUSPND bit, the USB
-    module may not be immediately operational while waiting for the 96 MHz
-    PLL to lock.
-    ********************************************************************/
-
-    // UIRbits.ACTVIF = 0;                      // Removed
-    #if defined(__18CXX) || defined(__XC8)
-    while(USBActivityIF)
-    #endif
-    {
-        USBClearInterruptFlag(USBActivityIFReg,USBActivityIFBitNum);
-    }  // Added
-
-    USBTicksSinceSuspendEnd = 0;
-
-}//end USBWakeFromSuspend
-
 /********************************************************************
  * Function:        void USBCtrlEPService(void)
  *
@@ -2769,6 +2650,7 @@ static void USBStdFeatureReqHandler(void)
 {
     BDT_ENTRY *p;
     EP_STATUS current_ep_data;
+    uint8_t cfgAttributes;
     #if defined(__C32__)
         uint32_t* pUEP;
     #else
@@ -2776,8 +2658,16 @@ static void USBStdFeatureReqHandler(void)
     #endif
 
     //Check if the host sent a valid SET or CLEAR feature (remote wakeup) request.
+    //Only a device whose configuration descriptor has _RWU accepts it, the
+    //others stall the request.
+    #if !defined(USB_USER_CONFIG_DESCRIPTOR)
+        cfgAttributes = (*USB_CD_Ptr)[7];
+    #else
+        cfgAttributes = (*USB_USER_CONFIG_DESCRIPTOR)[7];
+    #endif
     if((SetupPkt.bFeature == USB_FEATURE_DEVICE_REMOTE_WAKEUP)&&
-       (SetupPkt.Recipient == USB_SETUP_RECIPIENT_DEVICE_BITFIELD))
+       (SetupPkt.Recipient == USB_SETUP_RECIPIENT_DEVICE_BITFIELD)&&
+       ((cfgAttributes & _RWU) != 0))
     {
         inPipes[0].info.bits.busy = 1;
         if(SetupPkt.bRequest == USB_REQUEST_SET_FEATURE)
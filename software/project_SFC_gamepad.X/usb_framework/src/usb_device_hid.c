@@ -180,14 +180,14 @@ void USBCheckHIDRequest(void)
                     if(SetupPkt.bIntfID == 0) {
                         // Interface 0 - GamePad HID descriptor
                         USBEP0SendROMPtr(
-                            (const uint8_t*)&configDescriptor1 + 18,		//18 is a magic number.  It is the offset from start of the configuration descriptor to the start of the HID descriptor.
+                            *USBPersonality->config + 18,		//18 is a magic number.  It is the offset from start of the configuration descriptor to the start of the HID descriptor.
                             sizeof(USB_HID_DSC)+3,
                             USB_EP0_INCLUDE_ZERO);
                     }
                     else if(SetupPkt.bIntfID == 1) {
                         // Interface 1 - Mapping Feature HID descriptor
                         USBEP0SendROMPtr(
-                            (const uint8_t*)&configDescriptor1 + 45,		// offset from start of the configuration descriptor to the start of the second HID descriptor
+                            *USBPersonality->config + 45,		// offset from start of the configuration descriptor to the start of the second HID descriptor
                             sizeof(USB_HID_DSC)+3,
                             USB_EP0_INCLUDE_ZERO);
                     }
@@ -198,10 +198,10 @@ void USBCheckHIDRequest(void)
                 {
                     // Handle different interfaces - check which interface is requesting the descriptor
                     if(SetupPkt.bIntfID == 0) {
-                        // Interface 0 - GamePad report descriptor
+                        // Interface 0 - GamePad report descriptor of the active personality
                         USBEP0SendROMPtr(
-                            (const uint8_t*)&hid_rpt01,
-                            HID_RPT01_SIZE,     //See usbcfg.h
+                            USBPersonality->report,
+                            USBPersonality->reportSize,     //See usb_descriptors.c
                             USB_EP0_INCLUDE_ZERO);
                     }
                     else if(SetupPkt.bIntfID == 1) {
@@ -19,6 +19,13 @@ please contact mla_licensing@microchip.com
 *******************************************************************************/
 //DOM-IGNORE-END
 
+/*********************************************************************
+ * This file is modified by Geeky Fab.
+ * 
+ * Changes from the original source:
+ *     - USBSuspend() and USBWakeFromSuspend() (usb_device_suspend.c)
+ ********************************************************************/
+
 #include "usb_config.h"
 
 /* Short Packet States - Used by Control Transfer Read  - CTRL_TRF_TX */
@@ -422,3 +429,6 @@ typedef union
     #define USB_TRANSFER_COMPLETE_HANDLER(event,pointer,size)    USER_USB_CALLBACK_EVENT_HANDLER((USB_EVENT)event,pointer,size)
 #endif
 
+/* Bus suspend / wake up (usb_device_suspend.c), called by USBDeviceTasks() */
+void USBSuspend(void);
+void USBWakeFromSuspend(void);
@@ -0,0 +1,210 @@
+// DOM-IGNORE-BEGIN
+/*******************************************************************************
+Copyright 2015 Microchip Technology Inc. (www.microchip.com)
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+To request to license the code under the MLA license (www.microchip.com/mla_license),
+please contact mla_licensing@microchip.com
+*******************************************************************************/
+//DOM-IGNORE-END
+
+/*********************************************************************
+ * This file is modified by Geeky Fab.
+ * 
+ * Changes from the original source:
+ *     - split from usb_device.c: bus suspend, wake up and remote wakeup,
+ *       so that the host simulator runs the same code
+ ********************************************************************/
+
+#include <xc.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "usb_config.h"
+
+#include "usb.h"
+#include "usb_ch9.h"
+#include "usb_device.h"
+#include "usb_device_local.h"
+
+extern bool USER_USB_CALLBACK_EVENT_HANDLER(USB_EVENT event, void *pdata, uint16_t size);
+
+/********************************************************************
+ * Function:        void USBSuspend(void)
+ *
+ * PreCondition:    None
+ *
+ * Input:           None
+ *
+ * Output:          None
+ *
+ * Side Effects:
+ *
+ * Overview:        This function handles if the host tries to
+ *                  suspend the device
+ *
+ * Note:            None
+ *******************************************************************/
+void USBSuspend(void)
+{
+    /*
+     * NOTE: Do not clear UIRbits.ACTVIF here!
+     * Reason:
+     * ACTVIF is only generated once an IDLEIF has been generated.
+     * This is a 1:1 ratio interrupt generation.
+     * For every IDLEIF, there will be only one ACTVIF regardless of
+     * the number of subsequent bus transitions.
+     *
+     * If the ACTIF is cleared here, a problem could occur when:
+     * [       IDLE       ][bus activity ->
+     * <--- 3 ms ----->     ^
+     *                ^     ACTVIF=1
+     *                IDLEIF=1
+     *  #           #           #           #   (#=Program polling flags)
+     *                          ^
+     *                          This polling loop will see both
+     *                          IDLEIF=1 and ACTVIF=1.
+     *                          However, the program services IDLEIF first
+     *                          because ACTIVIE=0.
+     *                          If this routine clears the only ACTIVIF,
+     *                          then it can never get out of the suspend
+     *                          mode.
+     */
+    USBActivityIE = 1;                     // Enable bus activity interrupt
+    USBClearInterruptFlag(USBIdleIFReg,USBIdleIFBitNum);
+
+    #if defined(__18CXX) || defined(_PIC14E) || defined(__XC8)
+        U1CONbits.SUSPND = 1;                   // Put USB module in power conserve
+                                                // mode, SIE clock inactive
+    #endif
+    USBBusIsSuspended = true;
+    USBTicksSinceSuspendEnd = 0;
+
+    /*
+     * At this point the PIC can go into sleep,idle, or
+     * switch to a slower clock, etc.  This should be done in the
+     * USBCBSuspend() if necessary.
+     */
+    USB_SUSPEND_HANDLER(EVENT_SUSPEND,0,0);
+}
+
+/********************************************************************
+ * Function:        void USBWakeFromSuspend(void)
+ *
+ * PreCondition:    None
+ *
+ * Input:           None
+ *
+ * Output:          None
+ *
+ * Side Effects:    None
+ *
+ * Overview:
+ *
+ * Note:            None
+ *******************************************************************/
+void USBWakeFromSuspend(void)
+{
+    USBBusIsSuspended = false;
+
+    /*
+     * If using clock switching, the place to restore the original
+     * microcontroller core clock frequency is in the USBCBWakeFromSuspend() callback
+     */
+    USB_WAKEUP_FROM_SUSPEND_HANDLER(EVENT_RESUME,0,0);
+
+    #if defined(__18CXX) || defined(_PIC14E) || defined(__XC8)
+        //To avoid improperly clocking the USB module, make sure the oscillator
+        //settings are consistent with USB operation before clearing the SUSPND bit.
+        //Make sure the correct oscillator settings are selected in the
+        //"USB_WAKEUP_FROM_SUSPEND_HANDLER(EVENT_RESUME,0,0)" handler.
+        U1CONbits.SUSPND = 0;   // Bring USB module out of power conserve
+                                // mode.
+    #endif
+
+
+    USBActivityIE = 0;
+
+    /********************************************************************
+    Bug Fix: Feb 26, 2007 v2.1
+    *********************************************************************
+    The ACTVIF bit cannot be cleared immediately after the USB module wakes
+    up from Suspend or while the USB module is suspended. A few clock cycles
+    are required to synchronize the internal hardware state machine before
+    the ACTIVIF bit can be cleared by firmware. Clearing the ACTVIF bit
+    before the internal hardware is synchronized may not have an effect on
+    the value of ACTVIF. Additionally, if the USB module uses the clock from
+    the 96 MHz PLL source, then after clearing the SUSPND bit, the USB
+    module may not be immediately operational while waiting for the 96 MHz
+    PLL to lock.
+    ********************************************************************/
+
+    // UIRbits.ACTVIF = 0;                      // Removed
+    #if defined(__18CXX) || defined(__XC8)
+    while(USBActivityIF)
+    #endif
+    {
+        USBClearInterruptFlag(USBActivityIFReg,USBActivityIFBitNum);
+    }  // Added
+
+    USBTicksSinceSuspendEnd = 0;
+
+}//end USBWakeFromSuspend
+
+/********************************************************************
+ * Function:        bool USBCBSendResume(void)
+ *
+ * PreCondition:    None
+ *
+ * Input:           None
+ *
+ * Output:          true if the resume signalling was sent
+ *
+ * Side Effects:    Raises EVENT_RESUME (the clock is restored there)
+ *
+ * Overview:        Sends the remote wakeup signalling, if the host has
+ *                  enabled remote wakeup and the bus is suspended.
+ *
+ * Note:            Call this from the main loop, not from an event
+ *                  handler.  Blocks for about 4ms.
+ *******************************************************************/
+bool USBCBSendResume(void)
+{
+    //Make sure remote wakeup is enabled by host, and bus is suspended
+    if((USBGetRemoteWakeupStatus() == false) || (USBIsBusSuspended() == false))
+    {
+        return false;
+    }
+
+    USBMaskInterrupts();
+
+    //Clock switch to settings consistent with normal USB operation.
+    USB_WAKEUP_FROM_SUSPEND_HANDLER(EVENT_RESUME,0,0);
+    USBSuspendControl = 0;
+    USBBusIsSuspended = false;  //So we don't execute this code again, until a new suspend condition is detected.
+
+    //Section 7.1.7.7 of the USB 2.0 specification: the device must see 5ms+
+    //of idle on the bus before it sends remote wakeup signalling.  Suspend
+    //is detected after 3ms of idle, 2ms more makes sure of it.
+    _delay(24000);              //2ms at 12 MIPS
+
+    //Now drive the resume K-state signalling onto the USB bus (1-15ms).
+    USBResumeControl = 1;
+    _delay(24000);              //2ms
+    USBResumeControl = 0;
+
+    USBUnmaskInterrupts();
+    return true;
+}